@@ -12,6 +12,9 @@
 #include "xml6.h"
 #include "xml6_gbl.h"
 #include "xml6_ref.h"
+#include "xml6_node.h"
+#include "xml6_gc.h"
+#include "xml6_doc.h"
 #include <string.h>
 #include <assert.h>
 
@@ -95,122 +98,318 @@ _domRemoveNsDef(xmlNodePtr tree, xmlNsPtr ns) {
     return(0);
 }
 
-/* ns->next must be NULL, or bad things could happen */
+/* namespaces in scope, during reconciliation */
+typedef struct {
+    xmlNsPtr ns;
+    const xmlChar* key;     /* prefix, or "" for the default namespace */
+    int depth;              /* depth of the declaring element */
+    int own;                /* the element's own namespace, rather than a declaration */
+    size_t below;           /* index + 1 of the shadowed entry, or 0 */
+} _domNsScopeEntry;
+
+typedef struct {
+    xmlNodePtr top;         /* the tree being reconciled */
+    xmlHashTablePtr tops;   /* prefix -> index + 1 of innermost entry */
+    xmlHashTablePtr above;  /* prefix -> namespace in scope above the tree */
+    _domNsScopeEntry* entries;
+    size_t n;
+    size_t max;
+    int barrier;            /* entries below this depth are hidden by an entity */
+    xmlNsPtr unused;        /* removed declarations, to be freed */
+} _domNsScope;
+
+/* cached 'not found' result, for prefixes not in scope above the tree */
+static xmlNs _domNsNone;
+
+#define _domNsKey(prefix) ((prefix) != NULL ? (prefix) : BAD_CAST "")
+
+static int
+_domNsMatch(xmlNsPtr ns, const xmlChar* prefix) {
+    return ns->href != NULL
+        && (ns->prefix == NULL
+            ? prefix == NULL
+            : prefix != NULL && xmlStrEqual(ns->prefix, prefix));
+}
+
+/* As xmlSearchNs(), except that node's own namespace is also matched */
 static xmlNsPtr
-_domAddNsChain(xmlNsPtr c, xmlNsPtr ns) {
-    if( c == NULL )
-        return(ns);
-    else {
-        xmlNsPtr i = c;
-        while(i != NULL && i != ns)
-            i = i->next;
-        if(i == NULL) {
-            ns->next = c;
-            return(ns);
+_domSearchNsAbove(xmlDocPtr doc, xmlNodePtr node, const xmlChar* prefix) {
+    for (; node != NULL; node = node->parent) {
+        xmlNsPtr ns;
+        if (node->type == XML_ENTITY_REF_NODE
+            || node->type == XML_ENTITY_NODE
+            || node->type == XML_ENTITY_DECL) {
+            return NULL;
+        }
+        if (node->type == XML_ELEMENT_NODE) {
+            for (ns = node->nsDef; ns != NULL; ns = ns->next) {
+                if (_domNsMatch(ns, prefix)) return ns;
+            }
+            if (node->ns != NULL && _domNsMatch(node->ns, prefix)) {
+                return node->ns;
+            }
+        }
+    }
+    (void) doc;
+    return NULL;
+}
+
+static void
+_domNsScopePush(_domNsScope* self, xmlNsPtr ns, int depth, int own) {
+    const xmlChar* key;
+    size_t top;
+    _domNsScopeEntry* entry;
+
+    if (ns == NULL || ns->href == NULL) return;
+    key = _domNsKey(ns->prefix);
+    top = (size_t) xmlHashLookup(self->tops, key);
+
+    if (top && !own && !self->entries[top-1].own && self->entries[top-1].depth == depth) {
+        /* an earlier declaration on this element takes precedence */
+        return;
+    }
+
+    if (self->n >= self->max) {
+        self->max = self->max ? self->max * 2 : 32;
+        self->entries = (_domNsScopeEntry*) xmlRealloc(self->entries, self->max * sizeof(_domNsScopeEntry));
+        assert(self->entries != NULL);
+    }
+    entry = &(self->entries[self->n++]);
+    entry->ns = ns;
+    entry->key = key;
+    entry->depth = depth;
+    entry->own = own;
+    entry->below = top;
+    xmlHashUpdateEntry(self->tops, key, (void*) self->n, NULL);
+}
+
+/* Drop entries declared at or below the given depth */
+static void
+_domNsScopePop(_domNsScope* self, int depth) {
+    while (self->n > 0 && self->entries[self->n - 1].depth >= depth) {
+        _domNsScopeEntry* entry = &(self->entries[--self->n]);
+        if (entry->below) {
+            xmlHashUpdateEntry(self->tops, entry->key, (void*) entry->below, NULL);
+        }
+        else {
+            xmlHashRemoveEntry(self->tops, entry->key, NULL);
+        }
+    }
+}
+
+/* A declaration on the element with the same prefix and URI */
+static xmlNsPtr
+_domFindNsDef(xmlNodePtr tree, xmlNsPtr ns) {
+    xmlNsPtr def;
+    for (def = tree->nsDef; def != NULL; def = def->next) {
+        if (xmlStrEqual(def->prefix, ns->prefix) && xmlStrEqual(def->href, ns->href)) {
+            return def;
+        }
+    }
+    return NULL;
+}
+
+/* A namespace that isn't in scope; use or add a declaration on the element */
+static xmlNsPtr
+_domDeclareNs(xmlNodePtr tree, xmlNsPtr ns) {
+    xmlNsPtr def;
+
+    /* If the declaration is here, we don't need to do anything */
+    if( _domRemoveNsDef(tree, ns) ) {
+        _domAddNsDef(tree, ns);
+        return ns;
+    }
+
+    /* An equivalent declaration may already be here; e.g. added for the
+       element, then needed again by one of its attributes */
+    if( (def = _domFindNsDef(tree, ns)) != NULL ) {
+        return def;
+    }
+
+    /* Restart the namespace at this point */
+    def = xmlCopyNamespace(ns);
+    if (def) {
+        _domAddNsDef(tree, def);
+    }
+    return def;
+}
+
+/* Equivalent to xmlSearchNs(doc, node->parent, prefix), for a node at the
+   given depth, without walking the ancestor axis */
+static xmlNsPtr
+_domNsScopeLookup(_domNsScope* self, xmlNodePtr node, int depth, const xmlChar* prefix) {
+    size_t i;
+    xmlNsPtr ns;
+
+    if (depth == 0 || (prefix != NULL && xmlStrEqual(prefix, BAD_CAST "xml"))) {
+        return xmlSearchNs(node->doc, node->parent, prefix);
+    }
+
+    for (i = (size_t) xmlHashLookup(self->tops, _domNsKey(prefix)); i; i = self->entries[i-1].below) {
+        _domNsScopeEntry* entry = &(self->entries[i-1]);
+        if (entry->depth < self->barrier) return NULL;
+        /* the parent's own namespace isn't searched */
+        if (!(entry->own && entry->depth == depth - 1)) return entry->ns;
+    }
+
+    if (self->barrier) return NULL;
+
+    ns = (xmlNsPtr) xmlHashLookup(self->above, _domNsKey(prefix));
+    if (ns == NULL) {
+        ns = _domSearchNsAbove(node->doc, self->top->parent, prefix);
+        xmlHashAddEntry(self->above, _domNsKey(prefix), ns ? ns : &_domNsNone);
+    }
+    return ns == &_domNsNone ? NULL : ns;
+}
+
+static void
+_domReconcileNsDecl(_domNsScope* self, xmlNodePtr tree, xmlNsPtr* nsp, int depth) {
+    xmlNsPtr ns = _domNsScopeLookup(self, tree, depth, (*nsp)->prefix);
+
+    if( ns != NULL && ns->href != NULL && (*nsp)->href != NULL &&
+        xmlStrcmp(ns->href,(*nsp)->href) == 0 ) {
+        /* Remove the declaration (if present) */
+        if( _domRemoveNsDef(tree, *nsp) ) {
+            /* Queue the namespace for freeing */
+            (*nsp)->next = self->unused;
+            self->unused = *nsp;
         }
+
+        /* Replace the namespace with the one found */
+        *nsp = ns;
+    }
+    else {
+        *nsp = _domDeclareNs(tree, *nsp);
     }
-    return(c);
 }
 
 /* We need to be smarter with attributes, because the declaration is on the parent element */
 static void
-_domReconcileNsAttr(xmlAttrPtr attr, xmlNsPtr * unused) {
+_domReconcileNsAttr(_domNsScope* self, xmlAttrPtr attr, int depth) {
     xmlNodePtr tree = attr->parent;
-    if (tree == NULL)
+    if (tree == NULL || attr->ns == NULL)
         return;
-    if( attr->ns != NULL ) {
-        xmlNsPtr ns;
-        if ((attr->ns->prefix != NULL) &&
-            (xmlStrEqual(attr->ns->prefix, BAD_CAST "xml"))) {
-            /* prefix 'xml' has no visible declaration */
-            ns = xmlSearchNsByHref(tree->doc, tree, XML_XML_NAMESPACE);
-            attr->ns = ns;
-            return;
-        } else {
-            ns = xmlSearchNs( tree->doc, tree->parent, attr->ns->prefix );
-        }
+    if ((attr->ns->prefix != NULL) &&
+        (xmlStrEqual(attr->ns->prefix, BAD_CAST "xml"))) {
+        /* prefix 'xml' has no visible declaration */
+        attr->ns = xmlSearchNsByHref(tree->doc, tree, XML_XML_NAMESPACE);
+    }
+    else {
+        /* resolved from the element's scope, but declared on the element */
+        xmlNsPtr ns = _domNsScopeLookup(self, tree, depth, attr->ns->prefix);
         if( ns != NULL && ns->href != NULL && attr->ns->href != NULL &&
             xmlStrcmp(ns->href,attr->ns->href) == 0 ) {
-            /* Remove the declaration from the element */
-            if( _domRemoveNsDef(tree, attr->ns) )
-                /* Queue up this namespace for freeing */
-                *unused = _domAddNsChain(*unused, attr->ns);
-
-            /* Replace the namespace with the one found */
+            if( _domRemoveNsDef(tree, attr->ns) ) {
+                attr->ns->next = self->unused;
+                self->unused = attr->ns;
+            }
             attr->ns = ns;
         }
         else {
-            /* If the declaration is here, we don't need to do anything */
-            if( _domRemoveNsDef(tree, attr->ns) )
-                _domAddNsDef(tree, attr->ns);
-            else {
-                /* Replace/Add the namespace declaration on the element */
-                attr->ns = xmlCopyNamespace(attr->ns);
-                if (attr->ns) {
-                    _domAddNsDef(tree, attr->ns);
-                }
-            }
+            attr->ns = _domDeclareNs(tree, attr->ns);
         }
     }
 }
 
+static void
+_domReconcileNsElem(_domNsScope* self, xmlNodePtr tree, int depth) {
+    xmlAttrPtr attr;
+    xmlNsPtr ns;
+
+    if (tree->ns != NULL) {
+        _domReconcileNsDecl(self, tree, &(tree->ns), depth);
+    }
+    /* Fix attribute namespacing */
+    for (attr = tree->properties; attr != NULL; attr = attr->next) {
+        _domReconcileNsAttr(self, attr, depth);
+    }
+
+    /* declarations are now final; bring them into scope for descendants */
+    _domNsScopePush(self, tree->ns, depth, 1);
+    for (ns = tree->nsDef; ns != NULL; ns = ns->next) {
+        _domNsScopePush(self, ns, depth, 0);
+    }
+}
+
 /**
  * Name: _domReconcileNs
- * Synopsis: void _domReconcileNs( xmlNodePtr tree );
+ * Synopsis: xmlNsPtr _domReconcileNs( xmlNodePtr tree );
  * @tree: the tree to reconcile
  *
  * Reconciles namespacing on a tree by removing declarations
  * of element and attribute namespaces that are already
  * declared in the scope of the corresponding node.
+ *
+ * The tree is walked once, iteratively, carrying the namespaces
+ * declared within it, so the cost is linear in the size of the tree.
+ *
+ * Returns a list of the removed declarations.
  **/
 
-static void
-_domReconcileNs(xmlNodePtr tree, xmlNsPtr * unused) {
-    if (((tree->type == XML_ELEMENT_NODE)
-            || (tree->type == XML_ATTRIBUTE_NODE))
-        && tree->ns != NULL) {
-        xmlNsPtr ns = xmlSearchNs( tree->doc, tree->parent, tree->ns->prefix );
-        if( ns != NULL && ns->href != NULL && tree->ns->href != NULL &&
-            xmlStrcmp(ns->href,tree->ns->href) == 0 ) {
-            /* Remove the declaration (if present) */
-            if( _domRemoveNsDef(tree, tree->ns) )
-                /* Queue the namespace for freeing */
-                *unused = _domAddNsChain(*unused, tree->ns);
-
-            /* Replace the namespace with the one found */
-            tree->ns = ns;
-        }
-        else {
-            /* If the declaration is here, we don't need to do anything */
-            if( _domRemoveNsDef(tree, tree->ns) ) {
-                _domAddNsDef(tree, tree->ns);
+static xmlNsPtr
+_domReconcileNs(xmlNodePtr tree) {
+    _domNsScope scope;
+    xmlNodePtr cur = tree;
+    xmlNodePtr barrier_node = NULL;
+    int depth = 0;
+
+    memset(&scope, 0, sizeof(scope));
+    scope.top = tree;
+    scope.tops = xmlHashCreate(16);
+    scope.above = xmlHashCreate(16);
+
+    if (tree->type == XML_ATTRIBUTE_NODE) {
+        _domReconcileNsAttr(&scope, (xmlAttrPtr) tree, 0);
+        cur = NULL;
+    }
+
+    while (cur != NULL) {
+        if (cur->type == XML_ELEMENT_NODE) {
+            _domReconcileNsElem(&scope, cur, depth);
+        }
+        else if (barrier_node == NULL
+                 && (cur->type == XML_ENTITY_DECL || cur->type == XML_ENTITY_NODE)) {
+            /* namespaces aren't searched beyond an entity */
+            barrier_node = cur;
+            scope.barrier = depth + 1;
+        }
+
+        if (cur->children != NULL
+            && cur->type != XML_ENTITY_REF_NODE
+            && cur->type != XML_NAMESPACE_DECL
+            && cur->type != XML_ATTRIBUTE_NODE) {
+            cur = cur->children;
+            depth++;
+            continue;
+        }
+
+        /* ascend, leaving the scope of each completed node */
+        for (;;) {
+            _domNsScopePop(&scope, depth);
+            if (cur == barrier_node) {
+                barrier_node = NULL;
+                scope.barrier = 0;
             }
-            else {
-                /* Restart the namespace at this point */
-                tree->ns = xmlCopyNamespace(tree->ns);
-                _domAddNsDef(tree, tree->ns);
+            if (cur == tree) {
+                cur = NULL;
+                break;
             }
+            if (cur->next != NULL) {
+                cur = cur->next;
+                break;
+            }
+            cur = cur->parent;
+            depth--;
         }
     }
-    /* Fix attribute namespacing */
-    if (tree->type == XML_ELEMENT_NODE ) {
-        xmlElementPtr ele = (xmlElementPtr) tree;
-        /* attributes is set to xmlAttributePtr,
-           but is an xmlAttrPtr??? */
-        xmlAttrPtr attr = (xmlAttrPtr) ele->attributes;
-        while( attr != NULL ) {
-            _domReconcileNsAttr(attr, unused);
-            attr = attr->next;
-        }
-    }
-    if (tree->type != XML_NAMESPACE_DECL) {
-        /* Recurse through all child nodes */
-        xmlNodePtr child = tree->children;
-        while( child != NULL ) {
-            _domReconcileNs(child, unused);
-            child = child->next;
-        }
+
+    xmlHashFree(scope.tops, NULL);
+    xmlHashFree(scope.above, NULL);
+    if (scope.entries != NULL) {
+        xmlFree(scope.entries);
     }
+
+    return scope.unused;
 }
 
 static void _domRemoveEntityRefs(xmlNodePtr self, xmlDtdPtr dtd) {
@@ -235,6 +434,7 @@ static void _domRemoveEntityRefs(xmlNodePtr self, xmlDtdPtr dtd) {
 }
 
 DLLEXPORT void domUnlinkNode(xmlNodePtr self) {
+    xml6_node_refs_detach(self);
     xmlUnlinkNode(self);
 
     if (self != NULL && self->type == XML_DTD_NODE) {
@@ -248,8 +448,7 @@ DLLEXPORT void domUnlinkNode(xmlNodePtr self) {
 
 DLLEXPORT void
 domReconcileNs(xmlNodePtr tree) {
-    xmlNsPtr unused = NULL;
-    _domReconcileNs(tree, &unused);
+    xmlNsPtr unused = _domReconcileNs(tree);
     if( unused != NULL ) {
         // sanity check for externally referenced namespaces. shouldn't really happen
         int is_referenced = 0;
@@ -275,6 +474,7 @@ _domExtractFrag(xmlNodePtr frag) {
     // detach fragment list
     frag->children = frag->last = NULL;
     while ( cur ){
+        xml6_node_refs_detach(cur);
         cur->parent = NULL;
         cur = cur->next;
     }
@@ -321,6 +521,7 @@ domSetInternalSubset(xmlDocPtr self, xmlDtdPtr dtd) {
             xmlAddChild((xmlNodePtr) self, (xmlNodePtr) dtd);
         else
             xmlAddPrevSibling(self->children, (xmlNodePtr) dtd);
+        xml6_node_refs_attach((xmlNodePtr) dtd);
     }
     self->intSubset = dtd;
 
@@ -353,9 +554,42 @@ domSetExternalSubset(xmlDocPtr self, xmlDtdPtr dtd) {
     }
 
     self->extSubset = dtd;
+    xml6_node_refs_attach((xmlNodePtr) dtd);
     return dtd;
 }
 
+/**
+ * Name: domSetDocumentElement
+ * Synopsis: xmlNodePtr domSetDocumentElement(xmlDocPtr self, xmlNodePtr elem);
+ * @self: the document
+ * @elem: the new root element
+ *
+ * As for xmlDocSetRootElement(), but also keeps any referenced nodes
+ * counted. Returns the old root element, if any.
+ **/
+DLLEXPORT xmlNodePtr
+domSetDocumentElement(xmlDocPtr self, xmlNodePtr elem) {
+    xmlNodePtr old;
+
+    assert(self != NULL);
+
+    if (elem == NULL || elem->type == XML_NAMESPACE_DECL) {
+        return NULL;
+    }
+
+    old = xmlDocGetRootElement(self);
+    if (old == elem) {
+        return old;
+    }
+
+    xml6_node_refs_detach(old);
+    domUnlinkNode(elem);
+    xmlDocSetRootElement(self, elem);
+    xml6_node_refs_attach(elem);
+
+    return old;
+}
+
 DLLEXPORT xmlEntityPtr
 domGetEntityFromDtd(xmlDtdPtr dtd, xmlChar* name) {
     xmlEntitiesTablePtr table;
@@ -382,8 +616,16 @@ domGetParameterEntityFromDtd(xmlDtdPtr dtd, xmlChar* name) {
 static xmlNodePtr
 _domAssimulate(xmlNodePtr head, xmlNodePtr tail) {
     xmlNodePtr cur = head;
+    int elems = 0;
     while ( cur ) {
+        /* count any references from the new position */
+        xml6_node_refs_attach(cur);
         /* we must reconcile all nodes in the fragment */
+        if (cur->type == XML_ELEMENT_NODE) {
+            /* any document order stamps are from its previous position */
+            xml6_doc_order_unstamp(cur);
+            elems++;
+        }
         if (cur->type == XML_DTD_NODE) {
             if (_domIsDoc(cur->parent) == 0) {
                 xml6_warn("non-root DTD node found");
@@ -402,6 +644,10 @@ _domAssimulate(xmlNodePtr head, xmlNodePtr tail) {
         cur = cur->next;
     }
 
+    if (elems && head != NULL) {
+        xml6_doc_order_touch(head->doc);
+    }
+
     return head;
 }
 
@@ -601,74 +847,23 @@ domTestDocument(xmlNodePtr cur, xmlNodePtr refNode) {
     return 1;
 }
 
-static void _domScanEntry(void* value, int* refs, xmlChar* _name) {
-    (void)_name; /* unused parameter */
-    if (value != NULL && ((xmlNodePtr)value)->_private != NULL) {
-        (*refs)++;
-    }
-}
-
-static int
-_domScanHashForRefs(xmlHashTablePtr self) {
-    int refs = 0;
-    if (self != NULL) {
-        xmlHashScan(self, (xmlHashScanner)_domScanEntry, (void*) &refs);
-    }
-    return refs;
-}
-
 // Determine if there's any API references to a node or its descendants
 static int
 _domPeerIsReferenced(xmlNodePtr self) {
     assert(self != NULL);
 
-    // cheap checks
     if (self->type == XML_NAMESPACE_DECL) {
         return ((xmlNsPtr) self)->_private != NULL;
     }
-    else {
-        if (self->_private != NULL) {
-            return 1;
-        }
-    }
-
-    if (self->type == XML_ELEMENT_NODE) {
-        // scan element attributes
-        if (domNodeIsReferenced((xmlNodePtr)self->properties)) {
-            return 1;
-        }
-    }
-    else if (self->type == XML_DTD_NODE) {
-        xmlDtdPtr dtd = (xmlDtdPtr)self;
-        if (_domScanHashForRefs(dtd->elements)
-            || _domScanHashForRefs(dtd->attributes)
-            || _domScanHashForRefs(dtd->entities)) {
-            return 1;
-        }
-    }
-    else if (_domIsDoc(self)) {
-        // check external DtD
-        xmlDtdPtr dtd = ((xmlDocPtr) self)->extSubset;
-        if (dtd != NULL && _domPeerIsReferenced((xmlNodePtr)dtd)) {
-            return 1;
-        }
-    }
 
-    if (self->type == XML_ENTITY_DECL) {
-        xmlEntityPtr ent = (xmlEntityPtr) self;
-        if (ent->etype == XML_INTERNAL_PREDEFINED_ENTITY) {
-            // predefined entities are static. don't GC
-            return 1;
-        }
-    }
-    else if (self->type != XML_ENTITY_REF_NODE) {
-        // scan children
-        if (domNodeIsReferenced(self->children)) {
-            return 1;
-        }
+    if (self->type == XML_ENTITY_DECL
+        && ((xmlEntityPtr) self)->etype == XML_INTERNAL_PREDEFINED_ENTITY) {
+        // predefined entities are static. don't GC
+        return 1;
     }
 
-    return 0;
+    // any referenced descendants are counted by the node's reference
+    return self->_private != NULL;
 }
 
 // Determine if there's any API references in a node or its siblings
@@ -688,8 +883,7 @@ domReleaseNode( xmlNodePtr node ) {
     domUnlinkNode(node);
 
     if ( domNodeIsReferenced(node) == 0 ) {
-        node->_private = xml6_ref_freed();
-        xmlFreeNode(node);
+        xml6_gc_release(node);
     }
 }
 
@@ -723,6 +917,68 @@ domImportNode( xmlDocPtr doc, xmlNodePtr node, int move, int reconcileNS ) {
     return imported_node;
 }
 
+DLLEXPORT int
+domImportNodes( xmlDocPtr doc, xmlNodePtr* nodes, int n, int move, int reconcileNS, xmlNodePtr* imported ) {
+    xmlNode batch;
+    xmlNodePtr last = NULL;
+    xmlNodePtr cur;
+    int i;
+    int count = 0;
+
+    assert(nodes != NULL || n == 0);
+    assert(imported != NULL || n == 0);
+
+    /* elements are parked, as siblings, under a temporary fragment;
+       this is only seen by the reconciliation pass */
+    memset(&batch, 0, sizeof(batch));
+    batch.type = XML_DOCUMENT_FRAG_NODE;
+    batch.doc = doc;
+
+    for (i = 0; i < n; i++) {
+        xmlNodePtr node = nodes[i];
+        if (node != NULL && node->type == XML_ELEMENT_NODE) {
+            if (move) {
+                domUnlinkNode(node);
+                if (node->doc != doc) {
+                    xmlSetTreeDoc(node, doc);
+                }
+                imported[i] = node;
+            }
+            else {
+                /* already owned by doc; no need to set the tree doc */
+                imported[i] = xmlDocCopyNode(node, doc, 1);
+            }
+            if (imported[i] != NULL && reconcileNS && doc != NULL) {
+                imported[i]->parent = &batch;
+                imported[i]->prev = last;
+                if (last != NULL) {
+                    last->next = imported[i];
+                }
+                else {
+                    batch.children = imported[i];
+                }
+                batch.last = last = imported[i];
+            }
+        }
+        else {
+            imported[i] = domImportNode(doc, node, move, reconcileNS);
+        }
+        if (imported[i] != NULL) {
+            count++;
+        }
+    }
+
+    if (batch.children != NULL) {
+        domReconcileNs(&batch);
+        for (cur = batch.children; cur != NULL; cur = last) {
+            last = cur->next;
+            cur->parent = cur->next = cur->prev = NULL;
+        }
+    }
+
+    return count;
+}
+
 // DOM compliant.
 DLLEXPORT const xmlChar*
 domGetNodeName(xmlNodePtr node) {
@@ -960,7 +1216,8 @@ domAppendChild( xmlNodePtr self,
         // special case of appending root nodes to a document
         xmlDocPtr doc = (xmlDocPtr)self;
         if (xmlDocGetRootElement(doc) == NULL) {
-            xmlDocSetRootElement(doc, newChild);
+            xml6_doc_order_unstamp(newChild);
+            domSetDocumentElement(doc, newChild);
             return newChild;
         }
         else {
@@ -1087,6 +1344,7 @@ domReplaceChild( xmlNodePtr self, xmlNodePtr new, xmlNodePtr old ) {
             domAppendChild( self, new );
         }
         else {
+            xml6_node_refs_detach(old);
             head = _domAddNodeToList(new, old->prev, old->next, &tail );
             old->parent = old->next = old->prev = NULL;
             if ( head ) {
@@ -1235,7 +1493,9 @@ domRemoveChildNodes( xmlNodePtr self) {
 
     // reparent
     while ( cur ) {
+        xml6_node_refs_detach(cur);
         cur->parent = frag;
+        xml6_node_refs_attach(cur);
         cur = cur->next;
     }
     return frag;
@@ -1271,7 +1531,15 @@ domAddSibling( xmlNodePtr self, xmlNodePtr nNode ) {
         rv = _domSetDtd((xmlDocPtr)self->parent, (xmlDtdPtr)nNode, NULL);
     }
     else {
+        xml6_doc_order_unstamp(nNode);
+        domUnlinkNode(nNode);
         rv = xmlAddSibling( self, nNode );
+        if (rv == nNode) {
+            xml6_node_refs_attach(rv);
+        }
+        if (rv && rv->type == XML_ELEMENT_NODE) {
+            xml6_doc_order_touch(rv->doc);
+        }
     }
     return rv;
 }
@@ -1935,8 +2203,9 @@ domSetAttributeNode( xmlNodePtr self, xmlAttrPtr attr ) {
         }
         domReleaseNode( (xmlNodePtr)old );
     }
-    xmlUnlinkNode( (xmlNodePtr) attr );
+    domUnlinkNode( (xmlNodePtr) attr );
     _addAttr( self, attr);
+    xml6_node_refs_attach( (xmlNodePtr) attr );
 
     return attr;
 }
@@ -1968,8 +2237,9 @@ domSetAttributeNodeNS( xmlNodePtr self, xmlAttrPtr attr ) {
         domReleaseNode( (xmlNodePtr)old );
     }
 
-    xmlUnlinkNode( (xmlNodePtr) attr );
+    domUnlinkNode( (xmlNodePtr) attr );
     _addAttr( self, attr);
+    xml6_node_refs_attach( (xmlNodePtr) attr );
 
     return attr;
 }
@@ -2009,66 +2279,95 @@ domAttrSerializeContent(xmlAttrPtr attr) {
 }
 
 // check if prefix is of the form: base<digit+>
-static int _domPrefixMatch(const xmlChar* prefix, xmlChar* base) {
-    int len = xmlStrlen(base);
-    int matched = 0;
-    if (prefix && xmlStrncmp(prefix, base, len) == 0) {
-        while (prefix[len]) {
-            char d = prefix[len];
-            if (d >= '0' && d <= '9' && matched <= 5) {
-                matched++;
-            }
-            else {
-                // encountered non-digit, or too large; abort match
-                matched = 0;
-                break;
-            }
-            len++;
+/* suffixes are searched for in a bitmap of this many bits, on the stack */
+#define DOM_NS_SUFFIX_BITS 1024
+
+// returns the numeric suffix of a prefix of the form base<n>, or -1
+static int _domPrefixSuffix(const xmlChar* prefix, const xmlChar* base, int base_len) {
+    int n = 0;
+    int digits = 0;
+    if (prefix == NULL || xmlStrncmp(prefix, base, base_len) != 0) {
+        return -1;
+    }
+    for (prefix += base_len; *prefix; prefix++) {
+        if (*prefix < '0' || *prefix > '9' || digits >= 6) {
+            // encountered non-digit, or too large; abort match
+            return -1;
         }
+        n = n * 10 + (*prefix - '0');
+        digits++;
     }
-    return matched;
+    // a leading zero can't clash with a generated suffix
+    if (digits == 0 || (digits > 1 && prefix[-digits] == '0')) {
+        return -1;
+    }
+    return n;
 }
 
 DLLEXPORT const xmlChar*
 domGenNsPrefix(xmlNodePtr self, xmlChar* base) {
-    xmlChar* rv;
-    xmlNsPtr *all_ns = xmlGetNsList(self->doc, self);
-    xmlHashTablePtr hash = xmlHashCreate(10);
-    char entry[1];
+    unsigned char stack_used[DOM_NS_SUFFIX_BITS / 8];
+    unsigned char* used = stack_used;
+    xmlChar buf[128];
+    xmlChar* rv = buf;
+    xmlNodePtr node;
+    xmlNsPtr ns;
+    int base_len;
+    int matches = 0;
+    int seq;
 
     if (base == NULL || *base == 0) {
         base = (xmlChar*) "_ns";
     }
+    base_len = xmlStrlen(base);
 
-    if ( all_ns ) {
-        int i = 0;
-        xmlNsPtr ns = all_ns[i];
-        while ( ns ) {
-            if (_domPrefixMatch(ns->prefix, base)) {
-                // found an entry of the form base<n>
-                const xmlChar* key = ns->prefix;
-                if (xmlHashLookup(hash, (xmlChar*)key) == NULL) {
-                    xmlHashAddEntry(hash, xmlStrdup((xmlChar*)key), entry);
+    // The lowest free suffix can't exceed the number of matching
+    // prefixes, so only suffixes up to that count need to be tracked.
+    for (node = self; node != NULL; node = node->parent) {
+        if (node->type == XML_ELEMENT_NODE) {
+            for (ns = node->nsDef; ns != NULL; ns = ns->next) {
+                if (_domPrefixSuffix(ns->prefix, base, base_len) >= 0) {
+                    matches++;
                 }
             }
-            ns = all_ns[i++];
         }
-        xmlFree(all_ns);
     }
 
-    {
-        int seq;
-        int spare = 0;
-        rv = xmlMalloc(xmlStrlen(base) + 6);
-        // iterate until we generate an unused suffix
-        for (seq = 0; !spare; seq++) {
-            sprintf((char*)rv, "%s%d", base, seq);
-            spare = xmlHashLookup(hash, (xmlChar*)rv) == NULL;
+    if (matches >= DOM_NS_SUFFIX_BITS) {
+        used = xmlMalloc(matches / 8 + 1);
+        assert(used != NULL);
+    }
+    memset(used, 0, matches / 8 + 1);
+
+    if (matches) {
+        for (node = self; node != NULL; node = node->parent) {
+            if (node->type == XML_ELEMENT_NODE) {
+                for (ns = node->nsDef; ns != NULL; ns = ns->next) {
+                    int n = _domPrefixSuffix(ns->prefix, base, base_len);
+                    if (n >= 0 && n <= matches) {
+                        used[n / 8] |= 1 << (n % 8);
+                    }
+                }
+            }
         }
     }
 
-    xmlHashFree(hash, NULL);
-    return xml6_gbl_dict(rv);
+    for (seq = 0; used[seq / 8] & (1 << (seq % 8)); seq++) ;
+
+    if (used != stack_used) {
+        xmlFree(used);
+    }
+
+    if (base_len + 12 > (int) sizeof(buf)) {
+        rv = xmlMalloc(base_len + 12);
+        assert(rv != NULL);
+    }
+    sprintf((char*)rv, "%s%d", base, seq);
+
+    if (rv != buf) {
+        return xml6_gbl_dict(rv);
+    }
+    return xml6_gbl_dict_dup(rv);
 }
 
 DLLEXPORT int
@@ -2081,31 +2380,92 @@ domNormalizeList( xmlNodePtr nodelist ) {
     return(1);
 }
 
+/* Merge any following text nodes into this one, with a single allocation */
+static void
+_domMergeText( xmlNodePtr node ) {
+    xmlNodePtr next;
+    xmlChar* content;
+    size_t len = xmlStrlen(node->content);
+    size_t total = len;
+    xmlDictPtr dict = node->doc != NULL ? node->doc->dict : NULL;
+
+    if ( node->next == NULL || node->next->type != XML_TEXT_NODE )
+        return;
+
+    for ( next = node->next; next && next->type == XML_TEXT_NODE; next = next->next ) {
+        total += xmlStrlen(next->content);
+    }
+
+    if ( node->content != NULL
+         && node->content != (xmlChar*) &(node->properties)
+         && !(dict != NULL && xmlDictOwns(dict, node->content)) ) {
+        /* we own the content; extend it in place */
+        content = xmlRealloc(node->content, total + 1);
+        assert(content != NULL);
+    }
+    else {
+        content = xmlMalloc(total + 1);
+        assert(content != NULL);
+        if ( len ) memcpy(content, node->content, len);
+        node->properties = NULL;
+    }
+
+    while ( node->next && node->next->type == XML_TEXT_NODE ) {
+        size_t n;
+        next = node->next;
+        n = xmlStrlen(next->content);
+        if ( n ) memcpy(content + len, next->content, n);
+        len += n;
+        domReleaseNode( next );
+    }
+    content[len] = 0;
+    node->content = content;
+}
+
 DLLEXPORT int
 domNormalize( xmlNodePtr node ) {
-    xmlNodePtr next = NULL;
+    xmlNodePtr cur = node;
 
     if ( node == NULL )
         return(0);
 
-    switch ( node->type ) {
-    case XML_TEXT_NODE:
-        while ( node->next
-                && node->next->type == XML_TEXT_NODE ) {
-            next = node->next;
-            xmlNodeAddContent(node, next->content);
-            domReleaseNode( next );
+    while ( cur != NULL ) {
+        xmlNodePtr descend = NULL;
+
+        switch ( cur->type ) {
+        case XML_TEXT_NODE:
+            _domMergeText( cur );
+            break;
+        case XML_ELEMENT_NODE: {
+            /* attribute values are flat lists */
+            xmlAttrPtr attr;
+            xmlNodePtr kid;
+            for ( attr = cur->properties; attr != NULL; attr = attr->next ) {
+                for ( kid = attr->children; kid != NULL; kid = kid->next ) {
+                    if ( kid->type == XML_TEXT_NODE )
+                        _domMergeText( kid );
+                }
+            }
         }
-        break;
-    case XML_ELEMENT_NODE:
-        domNormalizeList( (xmlNodePtr) node->properties );
-        /* FALLTHRU */
-    case XML_ATTRIBUTE_NODE:
-    case XML_DOCUMENT_NODE:
-        return( domNormalizeList( node->children ) );
-        break;
-    default:
-        break;
+            /* FALLTHRU */
+        case XML_ATTRIBUTE_NODE:
+        case XML_DOCUMENT_NODE:
+            descend = cur->children;
+            break;
+        default:
+            break;
+        }
+
+        if ( descend != NULL ) {
+            cur = descend;
+            continue;
+        }
+
+        /* move on to the next sibling, ascending as needed */
+        while ( cur != node && cur->next == NULL ) {
+            cur = cur->parent;
+        }
+        cur = cur == node ? NULL : cur->next;
     }
     return(1);
 }
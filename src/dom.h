@@ -63,6 +63,9 @@ domSetInternalSubset(xmlDocPtr, xmlDtdPtr dtd);
 DLLEXPORT xmlDtdPtr
 domSetExternalSubset(xmlDocPtr, xmlDtdPtr dtd);
 
+DLLEXPORT xmlNodePtr
+domSetDocumentElement(xmlDocPtr, xmlNodePtr elem);
+
 DLLEXPORT xmlEntityPtr
 domGetEntityFromDtd(xmlDtdPtr dtd, xmlChar *name);
 
@@ -197,6 +200,22 @@ domReleaseNode( xmlNodePtr node );
 DLLEXPORT xmlNodePtr
 domImportNode( xmlDocPtr document, xmlNodePtr node, int move, int reconcileNS );
 
+/**
+ * NAME domImportNodes
+ * TYPE function
+ * SYNOPSIS
+ * count = domImportNodes( document, nodes, n, move, reconcileNS, imported );
+ *
+ * imports a list of n nodes to the given document, as domImportNode. The
+ * imported nodes are written to the imported array, which may be the same
+ * as the nodes array. Element nodes are reconciled together in a single
+ * pass.
+ *
+ * the function returns the number of nodes successfully imported.
+ */
+DLLEXPORT int
+domImportNodes( xmlDocPtr document, xmlNodePtr* nodes, int n, int move, int reconcileNS, xmlNodePtr* imported );
+
 DLLEXPORT xmlElementType
 domNodeType(xmlChar* name);
 
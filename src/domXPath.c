@@ -13,14 +13,17 @@
 #include <libxml/xpathInternals.h>
 #include <libxml/uri.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
 
 #include "dom.h"
 #include "domXPath.h"
 #include "xml6.h"
+#include "xml6_doc.h"
 #include "xml6_node.h"
 #include "xml6_ns.h"
 #include "xml6_ref.h"
+#include "xml6_ptr_hash.h"
 
 static xmlNodePtr _domItemOwner(xmlNodePtr item) {
     xmlNodePtr owner = NULL;
@@ -83,6 +86,26 @@ domNodeSetAtPos(xmlNodeSetPtr self, int i) {
     return NULL;
 }
 
+// Copies up to 'max' items, from position 'start', with their node types,
+// for bulk boxing. References are added to nodes, if requested.
+// Returns the number of items copied.
+DLLEXPORT int
+domNodeSetItems(xmlNodeSetPtr self, int start, int max, xmlNodePtr* items, int* types, int reference) {
+    int n = 0;
+    assert(self != NULL);
+    assert(items != NULL);
+    assert(types != NULL);
+
+    for (; start >= 0 && start < self->nodeNr && n < max; start++, n++) {
+        xmlNodePtr item = self->nodeTab[start];
+        items[n] = item;
+        types[n] = item->type;
+        if (reference) xml6_node_item_reference(item);
+    }
+
+    return n;
+}
+
 static xmlNodeSetPtr _domResizeNodeSet(xmlNodeSetPtr rv, int nodeMax) {
     xmlNodePtr *temp;
     int size;
@@ -194,6 +217,113 @@ DLLEXPORT xmlNodeSetPtr domReverseNodeSet(xmlNodeSetPtr rv) {
     return rv;
 }
 
+// re-stamp the document order of any stale documents in the set
+static void
+_domRefreshOrder(xmlNodeSetPtr self) {
+    xmlDocPtr last_doc = NULL;
+    int i;
+
+    for (i = 0; i < self->nodeNr; i++) {
+        xmlNodePtr item = self->nodeTab[i];
+        xmlDocPtr doc = item->type == XML_NAMESPACE_DECL ? NULL : item->doc;
+        if (doc != last_doc) {
+            xml6_doc_order_refresh(doc);
+            last_doc = doc;
+        }
+    }
+}
+
+/**
+ * Name: domSortNodeSet
+ * Synopsis: xmlNodeSetPtr domSortNodeSet(xmlNodeSetPtr self);
+ * @self: the node set
+ *
+ * Sorts a node set into document order, in place. Documents that have
+ * been stamped with their element order (xml6_doc_order_stamp) are
+ * compared by stamp; these are re-stamped first, if they have changed.
+ **/
+DLLEXPORT xmlNodeSetPtr
+domSortNodeSet(xmlNodeSetPtr self) {
+    if (self != NULL && self->nodeNr > 1) {
+        _domRefreshOrder(self);
+        xmlXPathNodeSetSort(self);
+    }
+    return self;
+}
+
+// a new set of the items in 'self' that are, or aren't, in 'other'
+static xmlNodeSetPtr
+_domNodeSetFilter(xmlNodeSetPtr self, xmlNodeSetPtr other, int keep) {
+    xmlNodeSetPtr rv = xmlXPathNodeSetCreate(NULL);
+    xml6PtrHashPtr seen = xml6_ptr_hash_new(other ? other->nodeNr : 0);
+    int i;
+
+    assert(rv != NULL);
+
+    if (other != NULL) {
+        for (i = 0; i < other->nodeNr; i++) {
+            xml6_ptr_hash_update(seen, other->nodeTab[i], other->nodeTab[i], NULL);
+        }
+    }
+
+    if (self != NULL) {
+        for (i = 0; i < self->nodeNr; i++) {
+            xmlNodePtr item = self->nodeTab[i];
+            if (xml6_ptr_hash_exists(seen, item) == keep) {
+                domPushNodeSet(rv, item, 0);
+            }
+        }
+    }
+
+    xml6_ptr_hash_free(seen, NULL);
+    return rv;
+}
+
+/**
+ * Name: domNodeSetUnion
+ * Synopsis: xmlNodeSetPtr domNodeSetUnion(xmlNodeSetPtr self, xmlNodeSetPtr other);
+ *
+ * Returns a new set of the distinct items in either set, in document
+ * order. Items are compared by identity, via a hash, rather than
+ * pairwise, as in xmlXPathNodeSetMerge().
+ **/
+DLLEXPORT xmlNodeSetPtr
+domNodeSetUnion(xmlNodeSetPtr self, xmlNodeSetPtr other) {
+    xmlNodeSetPtr rv = xmlXPathNodeSetCreate(NULL);
+    xml6PtrHashPtr seen = xml6_ptr_hash_new((self ? self->nodeNr : 0) + (other ? other->nodeNr : 0));
+    xmlNodeSetPtr sets[2];
+    int i, j;
+
+    assert(rv != NULL);
+    sets[0] = self;
+    sets[1] = other;
+
+    for (j = 0; j < 2; j++) {
+        if (sets[j] == NULL) continue;
+        for (i = 0; i < sets[j]->nodeNr; i++) {
+            xmlNodePtr item = sets[j]->nodeTab[i];
+            if (xml6_ptr_hash_update(seen, item, item, NULL) > 0) {
+                domPushNodeSet(rv, item, 0);
+            }
+        }
+    }
+
+    xml6_ptr_hash_free(seen, NULL);
+    return domSortNodeSet(rv);
+}
+
+// Returns a new set of the items in 'self' that are also in 'other', in the order of 'self'
+DLLEXPORT xmlNodeSetPtr
+domNodeSetIntersection(xmlNodeSetPtr self, xmlNodeSetPtr other) {
+    return _domNodeSetFilter(self, other, 1);
+}
+
+// Returns a new set of the items in 'self' that are not in 'other', in the order of 'self'
+DLLEXPORT xmlNodeSetPtr
+domNodeSetDifference(xmlNodeSetPtr self, xmlNodeSetPtr other) {
+    return _domNodeSetFilter(self, other, 0);
+}
+
 static void
 _domNodeSetGC(void *entry, unsigned char* _name) {
     xmlNodePtr twig = (xmlNodePtr) entry;
@@ -244,10 +374,293 @@ DLLEXPORT int domDeleteNodeSetItem(xmlNodeSetPtr self, xmlNodePtr item) {
     return pos;
 }
 
+#define _domIndexPos(index) ((xml6PtrHashPtr) (index)->pos)
+
+// Add to the count of live stamps
+static void
+_domIndexCount(domNodeSetIndexPtr index, int stamp, int delta) {
+    int i;
+    for (i = stamp + 1; i <= index->max; i += i & -i) {
+        index->live[i] += delta;
+    }
+}
+
+// The number of live stamps before this one, i.e. its position
+static int
+_domIndexRank(domNodeSetIndexPtr index, int stamp) {
+    int n = 0;
+    int i;
+    for (i = stamp; i > 0; i -= i & -i) {
+        n += index->live[i];
+    }
+    return n;
+}
+
+// The stamp of the item at a position
+static int
+_domIndexStampAt(domNodeSetIndexPtr index, int pos) {
+    int stamp = 0;
+    int bit = 1;
+    int rem = pos + 1;
+    while (bit * 2 <= index->max) bit *= 2;
+    for (; bit; bit /= 2) {
+        if (stamp + bit <= index->max && index->live[stamp + bit] < rem) {
+            stamp += bit;
+            rem -= index->live[stamp];
+        }
+    }
+    return stamp;
+}
+
+static int
+_domIndexHead(domNodeSetIndexPtr index, xmlNodePtr item) {
+    return (int) (intptr_t) xml6_ptr_hash_lookup(_domIndexPos(index), item) - 1;
+}
+
+static void
+_domIndexSetHead(domNodeSetIndexPtr index, xmlNodePtr item, int stamp) {
+    xml6_ptr_hash_update(_domIndexPos(index), item, (void*) (intptr_t) (stamp + 1), NULL);
+}
+
+// Add a live stamp to the item's occurrences, which are kept in stamp order
+static void
+_domIndexStamp(domNodeSetIndexPtr index, xmlNodePtr item, int stamp) {
+    int head = _domIndexHead(index, item);
+
+    _domIndexCount(index, stamp, 1);
+
+    if (head < 0) {
+        index->next[stamp] = 0;
+        _domIndexSetHead(index, item, stamp);
+    }
+    else {
+        index->dups++;
+        if (stamp < head) {
+            index->next[stamp] = head + 1;
+            _domIndexSetHead(index, item, stamp);
+        }
+        else {
+            int prev = head;
+            while (index->next[prev] && index->next[prev] - 1 < stamp) {
+                prev = index->next[prev] - 1;
+            }
+            index->next[stamp] = index->next[prev];
+            index->next[prev] = stamp + 1;
+        }
+    }
+}
+
+// Remove a stamp from the item's occurrences
+static void
+_domIndexUnstamp(domNodeSetIndexPtr index, xmlNodePtr item, int stamp) {
+    int head = _domIndexHead(index, item);
+    int next = index->next[stamp];
+
+    _domIndexCount(index, stamp, -1);
+
+    if (head == stamp) {
+        if (next) {
+            _domIndexSetHead(index, item, next - 1);
+        }
+        else {
+            xml6_ptr_hash_remove(_domIndexPos(index), item, NULL);
+        }
+    }
+    else {
+        int prev = head;
+        while (index->next[prev] != stamp + 1) {
+            prev = index->next[prev] - 1;
+        }
+        index->next[prev] = next;
+    }
+
+    if (head != stamp || next) {
+        index->dups--;
+    }
+    index->next[stamp] = 0;
+}
+
+static void
+_domNodeSetIndexBuild(xmlNodeSetPtr self, domNodeSetIndexPtr index) {
+    int i;
+    if (index->pos != NULL) {
+        xml6_ptr_hash_free(_domIndexPos(index), NULL);
+    }
+    if (index->live != NULL) {
+        xmlFree(index->live);
+        xmlFree(index->next);
+    }
+    // leave room to grow, before the stamps are exhausted
+    index->max = self->nodeNr * 2 + 16;
+    index->stamps = self->nodeNr;
+    index->live = (int*) xmlMalloc((index->max + 1) * sizeof(int));
+    index->next = (int*) xmlMalloc(index->max * sizeof(int));
+    assert(index->live != NULL);
+    assert(index->next != NULL);
+    memset(index->live, 0, (index->max + 1) * sizeof(int));
+    memset(index->next, 0, index->max * sizeof(int));
+    index->pos = xml6_ptr_hash_new(self->nodeNr);
+    index->dups = 0;
+
+    // count the initial stamps, in linear time
+    for (i = 1; i <= index->max; i++) {
+        int parent = i + (i & -i);
+        if (i <= index->stamps) index->live[i]++;
+        if (parent <= index->max) index->live[parent] += index->live[i];
+    }
+
+    // link occurrences, from last to first
+    for (i = self->nodeNr - 1; i >= 0; i--) {
+        xmlNodePtr item = self->nodeTab[i];
+        int head = _domIndexHead(index, item);
+        if (head >= 0) {
+            index->next[i] = head + 1;
+            index->dups++;
+        }
+        _domIndexSetHead(index, item, i);
+    }
+}
+
+/**
+ * Name: domNodeSetIndexNew
+ * Synopsis: domNodeSetIndexPtr domNodeSetIndexNew(xmlNodeSetPtr self);
+ * @self: the node set
+ *
+ * Creates an index of node set items to their positions. The index
+ * is kept up to date by the domNodeSetIndex*() functions; it must be
+ * rebuilt if the node-set is otherwise modified.
+ **/
+DLLEXPORT domNodeSetIndexPtr
+domNodeSetIndexNew(xmlNodeSetPtr self) {
+    domNodeSetIndexPtr index = (domNodeSetIndexPtr) xmlMalloc(sizeof(domNodeSetIndex));
+    assert(self != NULL);
+    assert(index != NULL);
+    memset(index, 0, sizeof(domNodeSetIndex));
+    _domNodeSetIndexBuild(self, index);
+    return index;
+}
+
+DLLEXPORT void
+domNodeSetIndexFree(domNodeSetIndexPtr index) {
+    if (index != NULL) {
+        xml6_ptr_hash_free(_domIndexPos(index), NULL);
+        xmlFree(index->live);
+        xmlFree(index->next);
+        xmlFree(index);
+    }
+}
+
+// Returns the position of the first occurrence of an item, or -1
+DLLEXPORT int
+domNodeSetIndexOf(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodePtr item) {
+    int stamp;
+    assert(self != NULL);
+    assert(index != NULL);
+    (void) self;
+    stamp = _domIndexHead(index, item);
+    return stamp < 0 ? -1 : _domIndexRank(index, stamp);
+}
+
+// As xmlXPathHasSameNodes(), i.e. the sets have at least one node in common
+DLLEXPORT int
+domNodeSetIndexHasSameNodes(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodeSetPtr other) {
+    int i;
+    assert(index != NULL);
+    if (self == NULL || other == NULL) {
+        return 0;
+    }
+    for (i = 0; i < other->nodeNr; i++) {
+        if (xml6_ptr_hash_exists(_domIndexPos(index), other->nodeTab[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+DLLEXPORT void
+domNodeSetIndexPush(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodePtr item, int reference) {
+    assert(index != NULL);
+    domPushNodeSet(self, item, reference);
+
+    if (index->stamps >= index->max) {
+        // stamps are exhausted; renumber them from the current positions
+        _domNodeSetIndexBuild(self, index);
+    }
+    else {
+        _domIndexStamp(index, self->nodeTab[self->nodeNr - 1], index->stamps++);
+    }
+}
+
+DLLEXPORT xmlNodePtr
+domNodeSetIndexPop(xmlNodeSetPtr self, domNodeSetIndexPtr index) {
+    xmlNodePtr item;
+    assert(self != NULL);
+    assert(index != NULL);
+
+    if (self->nodeNr <= 0) {
+        return NULL;
+    }
+
+    item = self->nodeTab[self->nodeNr - 1];
+    _domIndexUnstamp(index, item, _domIndexStampAt(index, self->nodeNr - 1));
+
+    return domPopNodeSet(self);
+}
+
+/**
+ * Name: domNodeSetIndexDelete
+ * Synopsis: int domNodeSetIndexDelete(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodePtr item, int keep_order);
+ * @self: the node set
+ * @index: its index
+ * @item: the item to delete
+ * @keep_order: preserve the order of the remaining items
+ *
+ * As domDeleteNodeSetItem(), but the item is located via the index.
+ * If keep_order is false, the last item is moved into the vacated
+ * position. Otherwise the following items are shifted down, with a
+ * single memmove(); their positions are maintained by the index in
+ * logarithmic time.
+ *
+ * Returns the position of the deleted item, or -1 if not found.
+ **/
+DLLEXPORT int
+domNodeSetIndexDelete(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodePtr item, int keep_order) {
+    int stamp = _domIndexHead(index, item);
+    int pos, last, last_stamp;
+
+    if (stamp < 0) {
+        return -1;
+    }
+
+    pos = _domIndexRank(index, stamp);
+    last = self->nodeNr - 1;
+    last_stamp = _domIndexStampAt(index, last);
+
+    _domIndexUnstamp(index, item, stamp);
+    self->nodeNr--;
+
+    if (keep_order) {
+        memmove(self->nodeTab + pos, self->nodeTab + pos + 1, (last - pos) * sizeof(xmlNodePtr));
+    }
+    else if (pos < last) {
+        // the last item takes over the vacated position and stamp
+        xmlNodePtr moved = self->nodeTab[last];
+        self->nodeTab[pos] = moved;
+        _domIndexUnstamp(index, moved, last_stamp);
+        _domIndexStamp(index, moved, stamp);
+    }
+
+    _domUnreferenceItem(item);
+    _domNodeSetGC(item, NULL);
+
+    return pos;
+}
+
 DLLEXPORT void
 domUnreferenceNodeSet(xmlNodeSetPtr self) {
     int i;
-    xmlHashTablePtr gc = xmlHashCreate(self->nodeNr);
+    // distinct trees, to be released
+    xml6PtrHashPtr gc = xml6_ptr_hash_new(self->nodeNr);
     xmlNodePtr last_twig = NULL;
 
     for (i = 0; i < self->nodeNr; i++) {
@@ -264,20 +677,17 @@ domUnreferenceNodeSet(xmlNodeSetPtr self) {
                 twig = xml6_node_find_root(twig);
 
                 if (twig != last_twig) {
-                    char key[20];
-                    sprintf(key, "%p", cur);
-
-                    if (xmlHashLookup(gc, (xmlChar*)key) == NULL) {
-                        xmlHashAddEntry(gc, xmlStrdup((xmlChar*)key), twig);
-                    }
-
+                    xml6_ptr_hash_update(gc, twig, twig, NULL);
                     last_twig = twig;
                 }
             }
         }
     }
 
-    xmlHashFree(gc, (xmlHashDeallocator) _domNodeSetGC);
+    xml6_ptr_hash_free(gc, (xmlHashDeallocator) _domNodeSetGC);
+    if (self->nodeTab != NULL) {
+        xmlFree(self->nodeTab);
+    }
     xmlFree(self);
 }
 
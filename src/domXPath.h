@@ -44,6 +44,9 @@ domUnreferenceNodeSet(xmlNodeSetPtr self);
 DLLEXPORT xmlNodePtr
 domNodeSetAtPos(xmlNodeSetPtr self, int i);
 
+DLLEXPORT int
+domNodeSetItems(xmlNodeSetPtr self, int start, int max, xmlNodePtr* items, int* types, int reference);
+
 DLLEXPORT void domPushNodeSet(xmlNodeSetPtr self, xmlNodePtr elem, int reference);
 
 DLLEXPORT xmlNodeSetPtr domCreateNodeSetFromList(xmlNodePtr elem, int keep_blanks);
@@ -52,10 +55,46 @@ DLLEXPORT xmlNodePtr domPopNodeSet(xmlNodeSetPtr self);
 
 DLLEXPORT int domDeleteNodeSetItem(xmlNodeSetPtr self, xmlNodePtr item);
 
+/* optional item -> position index, for fast lookup and deletion. Each
+   item is stamped in order; its position is the number of live stamps
+   before it, so removals don't need the following items to be updated */
+struct _domNodeSetIndex {
+    void* pos;      /* xml6PtrHashPtr, item -> stamp + 1 of its first occurrence */
+    int dups;       /* number of repeated items */
+    int* live;      /* Fenwick tree, counting live stamps */
+    int* next;      /* stamp -> stamp + 1 of the item's next occurrence, or 0 */
+    int stamps;     /* stamps issued */
+    int max;        /* stamps allocated; the index is rebuilt when exhausted */
+};
+typedef struct _domNodeSetIndex domNodeSetIndex;
+typedef domNodeSetIndex *domNodeSetIndexPtr;
+
+DLLEXPORT domNodeSetIndexPtr domNodeSetIndexNew(xmlNodeSetPtr self);
+
+DLLEXPORT void domNodeSetIndexFree(domNodeSetIndexPtr index);
+
+DLLEXPORT int domNodeSetIndexOf(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodePtr item);
+
+DLLEXPORT int domNodeSetIndexHasSameNodes(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodeSetPtr other);
+
+DLLEXPORT void domNodeSetIndexPush(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodePtr item, int reference);
+
+DLLEXPORT xmlNodePtr domNodeSetIndexPop(xmlNodeSetPtr self, domNodeSetIndexPtr index);
+
+DLLEXPORT int domNodeSetIndexDelete(xmlNodeSetPtr self, domNodeSetIndexPtr index, xmlNodePtr item, int keep_order);
+
 DLLEXPORT xmlNodeSetPtr domCopyNodeSet(xmlNodeSetPtr);
 
 DLLEXPORT xmlNodeSetPtr domReverseNodeSet(xmlNodeSetPtr);
 
+DLLEXPORT xmlNodeSetPtr domSortNodeSet(xmlNodeSetPtr);
+
+DLLEXPORT xmlNodeSetPtr domNodeSetUnion(xmlNodeSetPtr, xmlNodeSetPtr);
+
+DLLEXPORT xmlNodeSetPtr domNodeSetIntersection(xmlNodeSetPtr, xmlNodeSetPtr);
+
+DLLEXPORT xmlNodeSetPtr domNodeSetDifference(xmlNodeSetPtr, xmlNodeSetPtr);
+
 DLLEXPORT xmlNodeSetPtr domXPathSelectCtxt(xmlXPathContextPtr, xmlXPathCompExprPtr, xmlNodePtr refNode);
 
 #endif
@@ -0,0 +1,243 @@
+#include "xml6.h"
+#include "xml6_ast.h"
+#include "xml6_ref.h"
+#include "xml6_ns.h"
+#include <libxml/tree.h>
+#include <string.h>
+#include <assert.h>
+
+static const xmlChar*
+_xml6_ast_intern(xmlDocPtr doc, const xmlChar* name) {
+    if (doc != NULL && doc->dict != NULL) {
+        return xmlDictLookup(doc->dict, name, -1);
+    }
+    return xmlStrdup(name);
+}
+
+static void
+_xml6_ast_free_name(xmlDocPtr doc, const xmlChar* name) {
+    if (doc == NULL || doc->dict == NULL || !xmlDictOwns(doc->dict, name)) {
+        xmlFree((xmlChar*)name);
+    }
+}
+
+static const xmlChar*
+_xml6_ast_arg(const xmlChar** p, const xmlChar* end) {
+    const xmlChar* s = *p;
+    const xmlChar* nul = s < end ? memchr(s, 0, end - s) : NULL;
+
+    if (nul == NULL) {
+        return NULL;
+    }
+    *p = nul + 1;
+    return s;
+}
+
+// resolve the prefix of a qname, from the node upwards. An unprefixed
+// name is only resolved against the default namespace if 'deflt' is set.
+static xmlNsPtr
+_xml6_ast_search_ns(xmlNodePtr node, const xmlChar* qname, const xmlChar** local, int deflt) {
+    xmlChar buf[XML6_NS_PREFIX_MAX];
+    xmlChar* prefix;
+    const xmlChar* split = xml6_ns_split_qname(qname, buf, &prefix);
+    xmlNsPtr ns;
+
+    *local = qname;
+
+    if (split == NULL && (!deflt || xmlStrchr(qname, ':') != NULL)) {
+        return NULL;
+    }
+
+    ns = xmlSearchNs(node->doc, node, prefix);
+    xml6_ns_free_prefix(prefix, buf);
+
+    if (ns != NULL && split != NULL) {
+        *local = split;
+    }
+
+    return ns;
+}
+
+// called once all of an element's namespace declarations have been seen
+static void
+_xml6_ast_close_elem(xmlNodePtr elem) {
+    const xmlChar* local;
+    xmlNsPtr ns = _xml6_ast_search_ns(elem, elem->name, &local, 1);
+
+    if (ns != NULL) {
+        elem->ns = ns;
+        if (local != elem->name) {
+            const xmlChar* qname = elem->name;
+            elem->name = _xml6_ast_intern(elem->doc, local);
+            _xml6_ast_free_name(elem->doc, qname);
+        }
+    }
+}
+
+static void
+_xml6_ast_link(xmlNodePtr parent, xmlNodePtr node) {
+    node->parent = parent;
+    if (parent->last != NULL) {
+        parent->last->next = node;
+        node->prev = parent->last;
+    }
+    else {
+        parent->children = node;
+    }
+    parent->last = node;
+}
+
+/**
+ * Name: xml6_ast_build
+ * Synopsis: xmlNodePtr xml6_ast_build(xmlDocPtr doc, xmlNodePtr parent, const xmlChar* buf, size_t len);
+ * @doc: owner document, or NULL (defaults to parent->doc)
+ * @parent: node to append to, or NULL
+ * @buf: flat encoded AST, see xml6_ast.h
+ * @len: length of buf in bytes
+ *
+ * Constructs a tree from an encoded AST in a single pass. Element and
+ * attribute names are interned via the document dictionary, if any.
+ * Adjacent text nodes are not merged.
+ *
+ * Returns the first top-level node, which is linked to its siblings and
+ * appended to parent, if given, otherwise NULL on failure.
+ **/
+DLLEXPORT xmlNodePtr
+xml6_ast_build(xmlDocPtr doc, xmlNodePtr parent, const xmlChar* buf, size_t len) {
+    const xmlChar* p = buf;
+    const xmlChar* end = buf + len;
+    xmlNodePtr head = NULL;  /* first top-level node */
+    xmlNodePtr tail = NULL;  /* last top-level node */
+    xmlNodePtr cur = NULL;   /* innermost open element */
+    const char* err = NULL;
+
+    assert(buf != NULL || len == 0);
+
+    if (doc == NULL && parent != NULL) {
+        doc = parent->doc;
+    }
+
+    while (p < end && err == NULL) {
+        xmlChar op = *p++;
+        const xmlChar* s1 = NULL;
+        const xmlChar* s2 = NULL;
+        xmlNodePtr node = NULL;
+
+        switch (op) {
+        case XML6_AST_END:
+            break;
+        case XML6_AST_ATTR:
+        case XML6_AST_NS:
+        case XML6_AST_PI:
+            s2 = (s1 = _xml6_ast_arg(&p, end)) ? _xml6_ast_arg(&p, end) : NULL;
+            if (s2 == NULL) err = "truncated AST buffer";
+            break;
+        default:
+            s1 = _xml6_ast_arg(&p, end);
+            if (s1 == NULL) err = "truncated AST buffer";
+        }
+        if (err != NULL) break;
+
+        switch (op) {
+        case XML6_AST_ELEM:
+            node = xmlNewDocNodeEatName(doc, NULL, (xmlChar*)_xml6_ast_intern(doc, s1), NULL);
+            break;
+        case XML6_AST_END:
+            if (cur == NULL) {
+                err = "unbalanced AST element end";
+            }
+            else {
+                _xml6_ast_close_elem(cur);
+                cur = cur->parent == parent ? NULL : cur->parent;
+            }
+            continue;
+        case XML6_AST_ATTR:
+            if (cur == NULL) {
+                err = "AST attribute is not within an element";
+            }
+            else {
+                const xmlChar* local;
+                xmlNsPtr ns = _xml6_ast_search_ns(cur, s1, &local, 0);
+                if (xmlSetNsProp(cur, ns, local, s2) == NULL) {
+                    err = "unable to create AST attribute";
+                }
+            }
+            continue;
+        case XML6_AST_NS:
+            if (cur == NULL) {
+                err = "AST namespace is not within an element";
+            }
+            else {
+                // a NULL return is a re-declared prefix, which is ignored
+                xmlNewNs(cur, s2, *s1 ? s1 : NULL);
+            }
+            continue;
+        case XML6_AST_TEXT:
+            node = xmlNewDocText(doc, s1);
+            break;
+        case XML6_AST_COMMENT:
+            node = xmlNewDocComment(doc, s1);
+            break;
+        case XML6_AST_CDATA:
+            node = xmlNewCDataBlock(doc, s1, xmlStrlen(s1));
+            break;
+        case XML6_AST_PI:
+            node = xmlNewDocPI(doc, s1, s2);
+            break;
+        case XML6_AST_ENT_REF:
+            node = xmlNewReference(doc, s1);
+            break;
+        default:
+            err = "unknown AST op-code";
+            continue;
+        }
+
+        if (node == NULL) {
+            err = "unable to create AST node";
+            continue;
+        }
+
+        if (cur != NULL) {
+            _xml6_ast_link(cur, node);
+        }
+        else {
+            if (parent != NULL) {
+                _xml6_ast_link(parent, node);
+            }
+            else if (tail != NULL) {
+                tail->next = node;
+                node->prev = tail;
+            }
+            if (head == NULL) head = node;
+            tail = node;
+        }
+
+        if (op == XML6_AST_ELEM) {
+            cur = node;
+        }
+    }
+
+    if (err == NULL && cur != NULL) {
+        err = "unclosed AST element";
+    }
+
+    if (err != NULL) {
+        if (head != NULL) {
+            if (parent != NULL) {
+                // detach our nodes from the end of the parent's child list
+                if (head->prev != NULL) {
+                    head->prev->next = NULL;
+                }
+                else {
+                    parent->children = NULL;
+                }
+                parent->last = head->prev;
+                head->prev = NULL;
+            }
+            xmlFreeNodeList(head);
+        }
+        XML6_FAIL(parent, err);
+    }
+
+    return head;
+}
@@ -0,0 +1,21 @@
+#ifndef __XML6_AST_H
+#define __XML6_AST_H
+
+#include <libxml/parser.h>
+
+/* Op-codes for the flat AST encoding consumed by xml6_ast_build().
+ * Each op-code byte is followed by its NUL terminated string arguments.
+ */
+#define XML6_AST_ELEM    'E'  /* qname: open an element */
+#define XML6_AST_END     ')'  /* close the current element */
+#define XML6_AST_ATTR    'A'  /* qname, value: attribute on current element */
+#define XML6_AST_NS      'N'  /* prefix ("" for default), URI: namespace declaration */
+#define XML6_AST_TEXT    'T'  /* content: text node */
+#define XML6_AST_COMMENT 'C'  /* content: comment node */
+#define XML6_AST_CDATA   'D'  /* content: CDATA section */
+#define XML6_AST_PI      'P'  /* name, content: processing instruction */
+#define XML6_AST_ENT_REF 'R'  /* name: entity reference */
+
+DLLEXPORT xmlNodePtr xml6_ast_build(xmlDocPtr, xmlNodePtr, const xmlChar*, size_t);
+
+#endif /* __XML6_AST_H */
@@ -1,6 +1,8 @@
 #include "xml6.h"
 #include "xml6_doc.h"
 #include "xml6_ref.h"
+#include <libxml/xpath.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 
@@ -44,6 +46,14 @@ xml6_doc_set_flags(xmlDocPtr self, int flags) {
     return xml6_ref_set_flags( self->_private, flags);
 }
 
+// Sets flag bits, leaving the others as they are
+DLLEXPORT int
+xml6_doc_add_flags(xmlDocPtr self, int flags) {
+    assert(self != NULL);
+    assert(self->_private != NULL);
+    return xml6_ref_update_flags( self->_private, flags, 0);
+}
+
 DLLEXPORT int
 xml6_doc_get_flags(xmlDocPtr self) {
     assert(self != NULL);
@@ -51,3 +61,102 @@ xml6_doc_get_flags(xmlDocPtr self) {
     return xml6_ref_get_flags( self->_private);
 }
 
+
+/* Document order stamps. xmlXPathOrderDocElems() stamps each element's
+ * content field with its (negated) document position, which XPath uses
+ * in preference to walking the tree. An element moved after stamping would
+ * be mis-ordered, so moved subtrees are unstamped, and the document is
+ * flagged as stale, to be re-stamped on demand.
+ */
+
+#define _xml6_doc_is_stamped_elem(node) ((node)->type == XML_ELEMENT_NODE && ((ptrdiff_t) (node)->content) < 0)
+
+DLLEXPORT int
+xml6_doc_order_is_stamped(xmlDocPtr self) {
+    xmlNodePtr root = self ? xmlDocGetRootElement(self) : NULL;
+    return root != NULL && _xml6_doc_is_stamped_elem(root);
+}
+
+static void
+_xml6_doc_order_set_stale(xmlDocPtr self, int stale) {
+    if (self != NULL && self->_private != NULL) {
+        if (stale) {
+            xml6_ref_update_flags(self->_private, XML6_DOC_ORDER_STALE, 0);
+        }
+        else {
+            xml6_ref_update_flags(self->_private, 0, XML6_DOC_ORDER_STALE);
+        }
+    }
+}
+
+/**
+ * Name: xml6_doc_order_stamp
+ * Synopsis: long xml6_doc_order_stamp(xmlDocPtr self, int force);
+ * @self: the document
+ * @force: re-stamp, even if the stamps are current
+ *
+ * Stamps elements with their document order, if they haven't been
+ * stamped, or the document has been changed since.
+ *
+ * Returns the number of elements stamped, 0 if the stamps were current,
+ * or -1 on error.
+ **/
+DLLEXPORT long
+xml6_doc_order_stamp(xmlDocPtr self, int force) {
+    long n;
+    assert(self != NULL);
+
+    if (!force && xml6_doc_order_is_stamped(self) && self->_private != NULL
+        && !(xml6_ref_get_flags(self->_private) & XML6_DOC_ORDER_STALE)) {
+        return 0;
+    }
+
+    n = xmlXPathOrderDocElems(self);
+    _xml6_doc_order_set_stale(self, 0);
+    return n;
+}
+
+// re-stamp a document that has been stamped, but changed since
+DLLEXPORT void
+xml6_doc_order_refresh(xmlDocPtr self) {
+    if (self != NULL && self->_private != NULL
+        && (xml6_ref_get_flags(self->_private) & XML6_DOC_ORDER_STALE)) {
+        xml6_doc_order_stamp(self, 1);
+    }
+}
+
+// note that unstamped elements have been added to a document
+DLLEXPORT void
+xml6_doc_order_touch(xmlDocPtr self) {
+    if (self != NULL && self->_private != NULL && xml6_doc_order_is_stamped(self)) {
+        _xml6_doc_order_set_stale(self, 1);
+    }
+}
+
+// clear stamps from a subtree that is about to be moved
+DLLEXPORT void
+xml6_doc_order_unstamp(xmlNodePtr node) {
+    xmlNodePtr cur = node;
+
+    // stamped elements only have stamped ancestors; if this element
+    // isn't stamped, neither are its descendants
+    if (node == NULL || !_xml6_doc_is_stamped_elem(node)) {
+        return;
+    }
+
+    while (cur != NULL) {
+        if (cur->type == XML_ELEMENT_NODE) {
+            cur->content = NULL;
+            if (cur->children != NULL) {
+                cur = cur->children;
+                continue;
+            }
+        }
+        while (cur != node && cur->next == NULL) {
+            cur = cur->parent;
+        }
+        cur = cur == node ? NULL : cur->next;
+    }
+
+    _xml6_doc_order_set_stale(node->doc, 1);
+}
@@ -8,6 +8,16 @@ DLLEXPORT void xml6_doc_set_URI(xmlDocPtr, char* URI) ;
 DLLEXPORT void xml6_doc_set_version(xmlDocPtr, char*);
 DLLEXPORT int xml6_doc_set_doc_properties(xmlDocPtr, int);
 DLLEXPORT int xml6_doc_set_flags(xmlDocPtr, int);
+DLLEXPORT int xml6_doc_add_flags(xmlDocPtr, int);
 DLLEXPORT int xml6_doc_get_flags(xmlDocPtr);
 
+/* document flags, after LibXML::Document InputCompressed (1) */
+#define XML6_DOC_ORDER_STALE 2   /* elements have been added or moved since stamping */
+
+DLLEXPORT int xml6_doc_order_is_stamped(xmlDocPtr);
+DLLEXPORT long xml6_doc_order_stamp(xmlDocPtr, int);
+DLLEXPORT void xml6_doc_order_refresh(xmlDocPtr);
+DLLEXPORT void xml6_doc_order_touch(xmlDocPtr);
+DLLEXPORT void xml6_doc_order_unstamp(xmlNodePtr);
+
 #endif /* __XML6_DOC_H */
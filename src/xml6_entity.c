@@ -1,6 +1,14 @@
 #include "xml6.h"
 #include "xml6_entity.h"
+#include "xml6_gbl.h"
+#include <libxml/parserInternals.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+#include <libxml/uri.h>
+#include <libxml/xmlIO.h>
+#include <sys/stat.h>
 #include <string.h>
+#include <time.h>
 #include <assert.h>
 
 
@@ -42,3 +50,316 @@ xml6_entity_create(const xmlChar* name, int type,
 
     return(rv);
 }
+
+/* Process-wide cache of external entity and DTD content, keyed by
+ * canonical system ID. It's implemented as an external entity loader,
+ * which wraps the loader that was in place when it was enabled, and
+ * caches the raw bytes that loader returns. Entries are evicted, least
+ * recently used first, to keep within a byte limit. */
+
+typedef struct {
+    char* buf;
+    size_t len;
+    time_t mtime;            /* local files only, else 0 */
+    unsigned long used;      /* LRU stamp */
+} _xml6EntityCacheEntry;
+
+static xmlMutexPtr _ent_mutex = NULL;
+static xmlHashTablePtr _ent_cache = NULL;
+static xmlExternalEntityLoader _ent_next_loader = NULL;
+static size_t _ent_max = 0;
+static size_t _ent_size = 0;
+static int _ent_check_mtime = 0;
+static unsigned long _ent_clock = 0;
+static unsigned long _ent_hits = 0;
+static unsigned long _ent_misses = 0;
+
+static void _xml6_entity_cache_free_entry(void* payload, const xmlChar* name) {
+    _xml6EntityCacheEntry* entry = (_xml6EntityCacheEntry*) payload;
+    (void) name;
+    _ent_size -= entry->len;
+    xmlFree(entry->buf);
+    xmlFree(entry);
+}
+
+static int _xml6_entity_cache_is_local(const char* key) {
+    return xmlStrncasecmp((const xmlChar*) key, (const xmlChar*) "file://", 7) == 0
+        || strstr(key, "://") == NULL;
+}
+
+// modification time of a local file URI, or 0
+static time_t _xml6_entity_cache_mtime(const char* key) {
+    struct stat st;
+    time_t mtime = 0;
+    char* path = NULL;
+
+    if (xmlStrncasecmp((const xmlChar*) key, (const xmlChar*) "file://", 7) == 0) {
+        path = xmlURIUnescapeString(key + 7, 0, NULL);
+    }
+    else if (_xml6_entity_cache_is_local(key)) {
+        path = (char*) xmlStrdup((const xmlChar*) key);
+    }
+    if (path != NULL) {
+        if (stat(path, &st) == 0) mtime = st.st_mtime;
+        xmlFree(path);
+    }
+    return mtime;
+}
+
+typedef struct {
+    const xmlChar* name;
+    unsigned long used;
+} _xml6EntityCacheLRU;
+
+static void _xml6_entity_cache_lru_scan(void* payload, void* data, const xmlChar* name) {
+    _xml6EntityCacheEntry* entry = (_xml6EntityCacheEntry*) payload;
+    _xml6EntityCacheLRU* lru = (_xml6EntityCacheLRU*) data;
+    if (lru->name == NULL || entry->used < lru->used) {
+        lru->name = name;
+        lru->used = entry->used;
+    }
+}
+
+// evict entries until there's room for len more bytes; called with the mutex held
+static void _xml6_entity_cache_evict(size_t len) {
+    while (_ent_size + len > _ent_max && xmlHashSize(_ent_cache) > 0) {
+        _xml6EntityCacheLRU lru = { NULL, 0 };
+        xmlHashScan(_ent_cache, _xml6_entity_cache_lru_scan, &lru);
+        if (lru.name == NULL) break;
+        xmlHashRemoveEntry(_ent_cache, lru.name, _xml6_entity_cache_free_entry);
+    }
+}
+
+static xmlParserInputPtr
+_xml6_entity_cache_input(xmlParserCtxtPtr ctxt, const char* url, const char* buf, size_t len) {
+    xmlParserInputBufferPtr in = xmlParserInputBufferCreateMem(buf, (int) len, XML_CHAR_ENCODING_NONE);
+    xmlParserInputPtr input = NULL;
+
+    if (in != NULL) {
+        input = xmlNewIOInputStream(ctxt, in, XML_CHAR_ENCODING_NONE);
+        if (input == NULL) {
+            xmlFreeParserInputBuffer(in);
+        }
+        else if (input->filename == NULL && url != NULL) {
+            input->filename = (char*) xmlStrdup((const xmlChar*) url);
+        }
+    }
+    return input;
+}
+
+// Reads the remaining raw content of an input. Returns 1 on success, 0 if
+// the input can't be cached (it's being decoded), or -1 on a read error,
+// after which the input has been partly consumed.
+static int _xml6_entity_cache_slurp(xmlParserInputPtr input, char** buf, size_t* len) {
+    xmlParserInputBufferPtr in = input->buf;
+    xmlBufferPtr acc;
+    char chunk[4096];
+    int n;
+
+    if (in == NULL || in->encoder != NULL) return 0;
+
+    acc = xmlBufferCreate();
+    if (acc == NULL) return 0;
+
+    if (in->buffer != NULL && xmlBufUse(in->buffer) > 0) {
+        xmlBufferAdd(acc, xmlBufContent(in->buffer), (int) xmlBufUse(in->buffer));
+    }
+    if (in->readcallback != NULL) {
+        while ((n = (*in->readcallback)(in->context, chunk, sizeof(chunk))) > 0) {
+            xmlBufferAdd(acc, (xmlChar*) chunk, n);
+        }
+        if (n < 0) {
+            xmlBufferFree(acc);
+            return -1;
+        }
+    }
+
+    *len = xmlBufferLength(acc);
+    *buf = (char*) xmlBufferDetach(acc);
+    xmlBufferFree(acc);
+    return *buf != NULL ? 1 : -1;
+}
+
+static xmlParserInputPtr
+_xml6_entity_cache_loader(const char* url, const char* id, xmlParserCtxtPtr ctxt) {
+    // relative paths are keyed absolutely, as they may be loaded from different directories
+    xmlChar* key = xml6_gbl_absolute_path(url);
+    xmlParserInputPtr input = NULL;
+    _xml6EntityCacheEntry* entry;
+    time_t mtime = 0;
+    char* buf = NULL;
+    size_t len;
+    int stat;
+
+    if (key != NULL && ctxt != NULL && (ctxt->options & XML_PARSE_NONET)
+        && !_xml6_entity_cache_is_local((char*) key)) {
+        // may have been cached by a networked parse
+        xmlFree(key);
+        key = NULL;
+    }
+
+    if (key != NULL && ((ctxt != NULL && ctxt->inputNr == 0) || !xml6_gbl_is_default_loading())) {
+        // a top-level document, rather than a DTD or entity; or content that
+        // may be specific to the current input callbacks or loader
+        xmlFree(key);
+        key = NULL;
+    }
+
+    if (key == NULL) {
+        return _ent_next_loader ? (*_ent_next_loader)(url, id, ctxt) : NULL;
+    }
+
+    if (_ent_check_mtime) {
+        mtime = _xml6_entity_cache_mtime((char*) key);
+    }
+
+    xmlMutexLock(_ent_mutex);
+    entry = (_xml6EntityCacheEntry*) xmlHashLookup(_ent_cache, key);
+    if (entry != NULL && _ent_check_mtime && entry->mtime != mtime) {
+        xmlHashRemoveEntry(_ent_cache, key, _xml6_entity_cache_free_entry);
+        entry = NULL;
+    }
+    if (entry != NULL) {
+        entry->used = ++_ent_clock;
+        _ent_hits++;
+        // copied by xmlParserInputBufferCreateMem()
+        input = _xml6_entity_cache_input(ctxt, url, entry->buf, entry->len);
+    }
+    else {
+        _ent_misses++;
+    }
+    xmlMutexUnlock(_ent_mutex);
+
+    if (entry == NULL && _ent_next_loader != NULL) {
+        input = (*_ent_next_loader)(url, id, ctxt);
+
+        stat = input != NULL ? _xml6_entity_cache_slurp(input, &buf, &len) : 0;
+        if (stat < 0) {
+            // partly read; don't hand it back to the parser
+            xmlFreeInputStream(input);
+            input = NULL;
+        }
+        else if (stat > 0) {
+            xmlFreeInputStream(input);
+            input = _xml6_entity_cache_input(ctxt, url, buf, len);
+
+            xmlMutexLock(_ent_mutex);
+            if (len <= _ent_max && xmlHashLookup(_ent_cache, key) == NULL) {
+                entry = (_xml6EntityCacheEntry*) xmlMalloc(sizeof(_xml6EntityCacheEntry));
+                assert(entry != NULL);
+                _xml6_entity_cache_evict(len);
+                entry->buf = buf;
+                entry->len = len;
+                entry->mtime = mtime;
+                entry->used = ++_ent_clock;
+                xmlHashAddEntry(_ent_cache, key, entry);
+                _ent_size += len;
+                buf = NULL;
+            }
+            xmlMutexUnlock(_ent_mutex);
+
+            if (buf != NULL) xmlFree(buf);
+        }
+    }
+
+    xmlFree(key);
+    return input;
+}
+
+// Called once, from xml6_gbl_init(). The cache is initially disabled
+DLLEXPORT void xml6_entity_cache_init(void) {
+    assert(_ent_mutex == NULL);
+    _ent_mutex = xmlNewMutex();
+}
+
+/**
+ * Name: xml6_entity_cache_configure
+ * Synopsis: int xml6_entity_cache_configure(size_t max, int check_mtime);
+ * @max: maximum cached bytes; 0 disables the cache
+ * @check_mtime: revalidate cached local files against their modification times
+ *
+ * Enables, resizes or disables the cache. When enabled, the cache wraps
+ * the current external entity loader; when disabled, that loader is
+ * restored, if the cache is still installed.
+ *
+ * Returns 0, or -1 if the cache could not be enabled.
+ **/
+DLLEXPORT int xml6_entity_cache_configure(size_t max, int check_mtime) {
+    assert(_ent_mutex != NULL);
+    xmlMutexLock(_ent_mutex);
+    _ent_max = max;
+    _ent_check_mtime = check_mtime;
+
+    if (max > 0) {
+        if (_ent_cache == NULL) _ent_cache = xmlHashCreate(0);
+        _xml6_entity_cache_evict(0);
+        if (xmlGetExternalEntityLoader() != _xml6_entity_cache_loader) {
+            _ent_next_loader = xmlGetExternalEntityLoader();
+            xmlSetExternalEntityLoader(_xml6_entity_cache_loader);
+        }
+    }
+    else {
+        if (_ent_cache != NULL) {
+            xmlHashFree(_ent_cache, _xml6_entity_cache_free_entry);
+            _ent_cache = NULL;
+        }
+        if (xmlGetExternalEntityLoader() == _xml6_entity_cache_loader) {
+            xmlSetExternalEntityLoader(_ent_next_loader);
+        }
+        _ent_next_loader = NULL;
+    }
+    xmlMutexUnlock(_ent_mutex);
+
+    return (max == 0 || _ent_cache != NULL) ? 0 : -1;
+}
+
+// Replaces the loader beneath the cache; returns 1 if the cache is
+// installed over the 'from' loader, otherwise 0. Cached entries are discarded
+DLLEXPORT int xml6_entity_cache_replace_loader(xmlExternalEntityLoader from, xmlExternalEntityLoader to) {
+    int update;
+    assert(_ent_mutex != NULL);
+    xmlMutexLock(_ent_mutex);
+    update = xmlGetExternalEntityLoader() == _xml6_entity_cache_loader && _ent_next_loader == from;
+    if (update) {
+        _ent_next_loader = to;
+        xmlHashFree(_ent_cache, _xml6_entity_cache_free_entry);
+        _ent_cache = xmlHashCreate(0);
+    }
+    xmlMutexUnlock(_ent_mutex);
+    return update;
+}
+
+// The current external entity loader, or the loader beneath the cache
+DLLEXPORT xmlExternalEntityLoader xml6_entity_cache_next_loader(void) {
+    xmlExternalEntityLoader loader;
+    assert(_ent_mutex != NULL);
+    xmlMutexLock(_ent_mutex);
+    loader = xmlGetExternalEntityLoader();
+    if (loader == _xml6_entity_cache_loader) loader = _ent_next_loader;
+    xmlMutexUnlock(_ent_mutex);
+    return loader;
+}
+
+// Discards cached entries, and resets the statistics
+DLLEXPORT void xml6_entity_cache_clear(void) {
+    assert(_ent_mutex != NULL);
+    xmlMutexLock(_ent_mutex);
+    if (_ent_cache != NULL) {
+        xmlHashFree(_ent_cache, _xml6_entity_cache_free_entry);
+        _ent_cache = xmlHashCreate(0);
+    }
+    _ent_hits = _ent_misses = 0;
+    xmlMutexUnlock(_ent_mutex);
+}
+
+// Cache statistics: entries, bytes, hits and misses
+DLLEXPORT void xml6_entity_cache_stats(size_t* stats) {
+    assert(stats != NULL);
+    assert(_ent_mutex != NULL);
+    xmlMutexLock(_ent_mutex);
+    stats[0] = _ent_cache ? (size_t) xmlHashSize(_ent_cache) : 0;
+    stats[1] = _ent_size;
+    stats[2] = _ent_hits;
+    stats[3] = _ent_misses;
+    xmlMutexUnlock(_ent_mutex);
+}
@@ -2,10 +2,18 @@
 #define __XML6_ENTITY_H
 
 #include <libxml/entities.h>
+#include <libxml/parser.h>
 
 DLLEXPORT xmlEntityPtr
 xml6_entity_create(const xmlChar *name, int type,
                    const xmlChar *ExternalID, const xmlChar *SystemID,
                    const xmlChar *content);
 
+DLLEXPORT void xml6_entity_cache_init(void);
+DLLEXPORT int xml6_entity_cache_configure(size_t max, int check_mtime);
+DLLEXPORT int xml6_entity_cache_replace_loader(xmlExternalEntityLoader from, xmlExternalEntityLoader to);
+DLLEXPORT xmlExternalEntityLoader xml6_entity_cache_next_loader(void);
+DLLEXPORT void xml6_entity_cache_clear(void);
+DLLEXPORT void xml6_entity_cache_stats(size_t* stats);
+
 #endif /* __XML6_ENTITY_H */
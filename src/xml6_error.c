@@ -1,13 +1,18 @@
 #include "xml6.h"
 #include "xml6_error.h"
 #include <libxml/parser.h>
+#include <libxml/xmlversion.h>
+#include <string.h>
+#include <assert.h>
 
-DLLEXPORT xmlChar*
-xml6_error_context_and_column(xmlErrorPtr self, unsigned int* column) {
+#define XML6_ERROR_RING_MIN 16
+
+// copy the input line of a parser error into content; returns NULL if not available
+static xmlChar*
+_xml6_error_context(const xmlError* self, xmlChar content[XML6_ERROR_CONTEXT_LEN+1], unsigned int* column) {
     xmlParserInputPtr input;
     const xmlChar *cur, *base, *col_cur;
     unsigned int n, col;
-    xmlChar  content[81]; /* space for 80 chars + null terminator */
     xmlChar *ctnt;
     int domain = self->domain;
     xmlParserCtxtPtr ctxt = NULL;
@@ -36,7 +41,7 @@ xml6_error_context_and_column(xmlErrorPtr self, unsigned int* column) {
     }
     n = 0;
     /* search backwards for beginning-of-line (to max buff size) */
-    while ((n++ < (sizeof(content)-1)) && (cur > base) &&
+    while ((n++ < XML6_ERROR_CONTEXT_LEN) && (cur > base) &&
            (*(cur) != '\n') && (*(cur) != '\r'))
         cur--;
     /* search backwards for beginning-of-line for calculating the
@@ -53,11 +58,164 @@ xml6_error_context_and_column(xmlErrorPtr self, unsigned int* column) {
     ctnt = content;
     /* copy selected text to our buffer */
     while ((*cur != 0) && (*(cur) != '\n') &&
-           (*(cur) != '\r') && (n < sizeof(content)-1)) {
+           (*(cur) != '\r') && (n < XML6_ERROR_CONTEXT_LEN)) {
         *ctnt++ = *cur++;
         n++;
     }
     *ctnt = 0;
     *column = col;
-    return xmlStrdup(content);
+    return content;
+}
+
+DLLEXPORT xmlChar*
+xml6_error_context_and_column(xmlErrorPtr self, unsigned int* column) {
+    xmlChar content[XML6_ERROR_CONTEXT_LEN+1];
+    return _xml6_error_context(self, content, column) ? xmlStrdup(content) : NULL;
+}
+
+/**
+ * Name: xml6_error_ring_new
+ * Synopsis: xml6ErrorRingPtr xml6_error_ring_new(void);
+ *
+ * Creates a queue of errors, to be filled by xml6_error_ring_handler()
+ * and drained via xml6_error_ring_at() and xml6_error_ring_clear().
+ * Slots are reused, once drained. File names and context lines are
+ * interned, as these tend to repeat.
+ **/
+DLLEXPORT xml6ErrorRingPtr
+xml6_error_ring_new(void) {
+    xml6ErrorRingPtr self = (xml6ErrorRingPtr) xmlMalloc(sizeof(xml6ErrorRing));
+    assert(self != NULL);
+    memset(self, 0, sizeof(xml6ErrorRing));
+    self->dict = xmlDictCreate();
+    return self;
+}
+
+DLLEXPORT void
+xml6_error_ring_free(xml6ErrorRingPtr self) {
+    if (self != NULL) {
+        xml6_error_ring_clear(self);
+        if (self->entries != NULL) xmlFree(self->entries);
+        xmlDictFree(self->dict);
+        xmlFree(self);
+    }
+}
+
+static void
+_xml6_error_ring_grow(xml6ErrorRingPtr self) {
+    int size = self->size ? self->size * 2 : XML6_ERROR_RING_MIN;
+    xml6ErrorEntryPtr entries = (xml6ErrorEntryPtr) xmlMalloc(size * sizeof(xml6ErrorEntry));
+    int i;
+    assert(entries != NULL);
+
+    // unwrap, so that the oldest entry is first
+    for (i = 0; i < self->elems; i++) {
+        entries[i] = self->entries[(self->head + i) % self->size];
+    }
+    if (self->entries != NULL) xmlFree(self->entries);
+    self->entries = entries;
+    self->size = size;
+    self->head = 0;
+}
+
+// Structured error handler (xmlStructuredErrorFunc); data is the ring
+DLLEXPORT void
+xml6_error_ring_handler(void* data, xml6ConstErrorPtr err) {
+    xml6ErrorRingPtr self = (xml6ErrorRingPtr) data;
+    xml6ErrorEntryPtr entry;
+    xmlChar content[XML6_ERROR_CONTEXT_LEN+1];
+    unsigned int column = 0;
+
+    if (self == NULL || err == NULL) return;
+
+    if ((int) err->level <= self->suppress || (self->max && self->count > self->max)) {
+        return;
+    }
+    self->count++;
+
+    if (self->elems >= self->size) {
+        _xml6_error_ring_grow(self);
+    }
+
+    entry = &(self->entries[(self->head + self->elems) % self->size]);
+    entry->domain = err->domain;
+    entry->code = err->code;
+    entry->level = err->level;
+    entry->line = err->line;
+    entry->file = err->file ? xmlDictLookup(self->dict, (xmlChar*) err->file, -1) : NULL;
+    entry->message = err->message ? xmlStrdup((xmlChar*) err->message) : NULL;
+    // the parser input is transient, so the context is taken now
+    entry->context = _xml6_error_context(err, content, &column)
+        ? xmlDictLookup(self->dict, content, -1)
+        : NULL;
+    entry->column = column ? (int) column : err->int2;
+
+    self->elems++;
+}
+
+/**
+ * Name: xml6_error_ring_set_limits
+ * Synopsis: void xml6_error_ring_set_limits(xml6ErrorRingPtr self, int suppress, int max);
+ * @self: the error queue
+ * @suppress: discard errors at or below this level, e.g. XML_ERR_WARNING
+ * @max: maximum number of errors, or 0 for no limit
+ *
+ * Sets limits, so that suppressed errors, and errors beyond the limit,
+ * are discarded by the handler. One error over the limit is queued, to
+ * signal that the limit was reached. Resets the count of queued errors.
+ **/
+DLLEXPORT void
+xml6_error_ring_set_limits(xml6ErrorRingPtr self, int suppress, int max) {
+    assert(self != NULL);
+    self->suppress = suppress;
+    self->max = max > 0 ? max : 0;
+    self->count = 0;
+}
+
+// Directs a parser context's errors to the ring, or restores default handling.
+// Returns 0 on success, or -1 if per-context error handlers aren't supported.
+DLLEXPORT int
+xml6_error_ring_attach(xmlParserCtxtPtr ctxt, xml6ErrorRingPtr self) {
+    assert(ctxt != NULL);
+#if LIBXML_VERSION >= 21300
+    if (self != NULL) {
+        xmlCtxtSetErrorHandler(ctxt, xml6_error_ring_handler, self);
+    }
+    else {
+        xmlCtxtSetErrorHandler(ctxt, NULL, NULL);
+    }
+    return 0;
+#else
+    (void) self;
+    return -1;
+#endif
+}
+
+DLLEXPORT int
+xml6_error_ring_elems(xml6ErrorRingPtr self) {
+    return self ? self->elems : 0;
+}
+
+// Returns the i-th oldest queued error
+DLLEXPORT xml6ErrorEntryPtr
+xml6_error_ring_at(xml6ErrorRingPtr self, int i) {
+    assert(self != NULL);
+    if (i < 0 || i >= self->elems) return NULL;
+    return &(self->entries[(self->head + i) % self->size]);
+}
+
+// Discards queued errors
+DLLEXPORT void
+xml6_error_ring_clear(xml6ErrorRingPtr self) {
+    int i;
+    assert(self != NULL);
+    for (i = 0; i < self->elems; i++) {
+        xml6ErrorEntryPtr entry = xml6_error_ring_at(self, i);
+        if (entry->message != NULL) {
+            xmlFree(entry->message);
+            entry->message = NULL;
+        }
+    }
+    self->head = (self->head + self->elems) % (self->size ? self->size : 1);
+    self->elems = 0;
 }
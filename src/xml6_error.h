@@ -3,8 +3,56 @@
 
 #include <libxml/xmlstring.h>
 #include <libxml/xmlerror.h>
+#include <libxml/parser.h>
+#include <libxml/dict.h>
+
+/* error argument of an xmlStructuredErrorFunc; const from libxml2 v2.12 */
+#if LIBXML_VERSION >= 21200
+typedef const xmlError* xml6ConstErrorPtr;
+#else
+typedef xmlErrorPtr xml6ConstErrorPtr;
+#endif
+
+/* maximum length of an error context line */
+#define XML6_ERROR_CONTEXT_LEN 80
+
+struct _xml6ErrorEntry {
+    int domain;
+    int code;
+    int level;
+    int line;
+    int column;
+    const xmlChar* file;     /* interned */
+    xmlChar* message;
+    const xmlChar* context;  /* interned */
+};
+typedef struct _xml6ErrorEntry xml6ErrorEntry;
+typedef xml6ErrorEntry *xml6ErrorEntryPtr;
+
+/* circular queue of errors, collected natively */
+struct _xml6ErrorRing {
+    int size;                /* number of slots */
+    int head;                /* oldest entry */
+    int elems;               /* number of queued entries */
+    int suppress;            /* discard errors at or below this level */
+    int max;                 /* queue at most max + 1 errors; 0 for no limit */
+    int count;               /* errors queued since the limits were set */
+    xml6ErrorEntryPtr entries;
+    xmlDictPtr dict;
+};
+typedef struct _xml6ErrorRing xml6ErrorRing;
+typedef xml6ErrorRing *xml6ErrorRingPtr;
 
 DLLEXPORT xmlChar*
 xml6_error_context_and_column(xmlErrorPtr, unsigned int*);
 
+DLLEXPORT xml6ErrorRingPtr xml6_error_ring_new(void);
+DLLEXPORT void xml6_error_ring_free(xml6ErrorRingPtr);
+DLLEXPORT void xml6_error_ring_handler(void*, xml6ConstErrorPtr);
+DLLEXPORT int xml6_error_ring_attach(xmlParserCtxtPtr, xml6ErrorRingPtr);
+DLLEXPORT void xml6_error_ring_set_limits(xml6ErrorRingPtr, int, int);
+DLLEXPORT int xml6_error_ring_elems(xml6ErrorRingPtr);
+DLLEXPORT xml6ErrorEntryPtr xml6_error_ring_at(xml6ErrorRingPtr, int);
+DLLEXPORT void xml6_error_ring_clear(xml6ErrorRingPtr);
+
 #endif /* __XML6_ERROR_H */
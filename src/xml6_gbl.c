@@ -1,9 +1,20 @@
 #include "xml6.h"
 #include "xml6_gbl.h"
+#include "xml6_entity.h"
+#include "xml6_gc.h"
+#include "xml6_input.h"
+#include "xml6_ref.h"
+#include "xml6_schema.h"
 #include <libxml/parser.h>
 #include <libxml/threads.h>
+#include <libxml/uri.h>
 #include <libxml/xmlIO.h>
 #include <stdarg.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
 #include <string.h>
 #include <assert.h>
 
@@ -18,9 +29,15 @@ DLLEXPORT void xml6_gbl_init(void) {
     assert(_default_ext_entity_loader == NULL);
     assert(_cache == NULL);
     assert(_cache_mutex == NULL);
-    _default_ext_entity_loader = xmlGetExternalEntityLoader();
     _cache_mutex = xmlNewMutex();
     _cache = xmlDictCreate();
+    xml6_ref_init();
+    xml6_gc_init();
+    // installs the mapped input loader, over libxml2's default loader
+    xml6_input_init();
+    _default_ext_entity_loader = xmlGetExternalEntityLoader();
+    xml6_entity_cache_init();
+    xml6_schema_init();
 }
 
 DLLEXPORT void* xml6_gbl_get_external_entity_loader(void) {
@@ -32,20 +49,27 @@ DLLEXPORT void xml6_gbl_set_external_entity_loader(void *loader) {
 }
 
 DLLEXPORT int xml6_gbl_set_external_entity_loader_net(int net) {
-    int update = 0;
-
-    if (net) {
-        update = xmlGetExternalEntityLoader() == xmlNoNetExternalEntityLoader;
-        if (update) xmlSetExternalEntityLoader(_default_ext_entity_loader);
-    }
-    else {
-        update = xmlGetExternalEntityLoader() == _default_ext_entity_loader;
-        if (update) xmlSetExternalEntityLoader(xmlNoNetExternalEntityLoader);
+    xmlExternalEntityLoader from = net ? xml6_input_map_loader_nonet : _default_ext_entity_loader;
+    xmlExternalEntityLoader to = net ? _default_ext_entity_loader : xml6_input_map_loader_nonet;
+    // update the loader beneath the entity cache, if it's enabled
+    int update = xml6_entity_cache_replace_loader(from, to);
+
+    if (!update) {
+        update = xmlGetExternalEntityLoader() == from;
+        if (update) xmlSetExternalEntityLoader(to);
     }
 
     return update;
 }
 
+// Whether external resources are loaded by libxml2 itself, i.e. there are
+// no input callbacks, and the entity loader is the default or no-network loader
+DLLEXPORT int xml6_gbl_is_default_loading(void) {
+    xmlExternalEntityLoader loader = xml6_entity_cache_next_loader();
+    return !xml6_input_has_callbacks()
+        && (loader == _default_ext_entity_loader || loader == xml6_input_map_loader_nonet);
+}
+
 /*
  * Note: xmlSaveNoEmptyTags, xmlKeepBlanksDefaultValue and
  * xmlLastError are macros defined in libxml/globals.h.
@@ -80,6 +104,76 @@ DLLEXPORT void xml6_gbl_os_thread_set_keep_blanks(int flag) {
 #endif
 }
 
+/**
+ * Name: xml6_gbl_os_thread_swap_flags
+ * Synopsis: int xml6_gbl_os_thread_swap_flags(int flags);
+ * @flags: XML6_GBL_TAG_EXPANSION and/or XML6_GBL_KEEP_BLANKS
+ *
+ * Sets the OS thread's tag-expansion and keep-blanks globals in a single
+ * call, only writing those that differ.
+ *
+ * Returns the previous flags, which may be passed back to restore them.
+ **/
+DLLEXPORT int xml6_gbl_os_thread_swap_flags(int flags) {
+    int tag_expansion = xml6_gbl_os_thread_get_tag_expansion();
+    int keep_blanks = xml6_gbl_os_thread_get_keep_blanks();
+    int want = (flags & XML6_GBL_TAG_EXPANSION) ? 1 : 0;
+    int prev = tag_expansion ? XML6_GBL_TAG_EXPANSION : 0;
+
+    if (tag_expansion != want) xml6_gbl_os_thread_set_tag_expansion(want);
+
+    if (keep_blanks < 0) {
+        // not a global; leave as requested
+        prev |= flags & XML6_GBL_KEEP_BLANKS;
+    }
+    else {
+        want = (flags & XML6_GBL_KEEP_BLANKS) ? 1 : 0;
+        if (keep_blanks) prev |= XML6_GBL_KEEP_BLANKS;
+        if (keep_blanks != want) xml6_gbl_os_thread_set_keep_blanks(want);
+    }
+
+    return prev;
+}
+
+// Is this the process's working directory?
+DLLEXPORT int xml6_gbl_is_cwd(const char* dir) {
+    char buf[4096];
+#ifdef _WIN32
+    const char* cwd = _getcwd(buf, sizeof(buf));
+#else
+    const char* cwd = getcwd(buf, sizeof(buf));
+#endif
+    return dir != NULL && cwd != NULL && strcmp(cwd, dir) == 0;
+}
+
+// Canonical form of a URL or path, with relative local paths made absolute
+// against the working directory; e.g. for use as a cache key. Free with xmlFree().
+DLLEXPORT xmlChar* xml6_gbl_absolute_path(const char* url) {
+    char buf[4096];
+    const char* cwd;
+    xmlChar* path;
+    xmlChar* abs;
+
+    if (url == NULL) return NULL;
+    path = xmlCanonicPath((const xmlChar*) url);
+    if (path == NULL || strstr((char*) path, "://") != NULL
+        || path[0] == '/' || path[0] == '\\'
+        || (path[0] != 0 && path[1] == ':')) {
+        return path;
+    }
+#ifdef _WIN32
+    cwd = _getcwd(buf, sizeof(buf));
+#else
+    cwd = getcwd(buf, sizeof(buf));
+#endif
+    if (cwd == NULL) return path;
+    abs = xmlStrdup((const xmlChar*) cwd);
+    abs = xmlStrcat(abs, (const xmlChar*) "/");
+    abs = xmlStrcat(abs, path);
+    xmlFree(path);
+    return abs;
+}
+
 DLLEXPORT void xml6_gbl_os_thread_xml_free(void* obj) {
     xmlFree(obj);
 }
@@ -206,7 +300,7 @@ DLLEXPORT const xmlChar* xml6_gbl_dict_dup(const xmlChar* word) {
 #ifdef DEBUG
             _cache_size++;
 #endif
-            key = xmlDictLookup(_cache, xmlStrdup(word), word_len);
+            key = xmlDictLookup(_cache, word, word_len);
         }
         xmlMutexUnlock(_cache_mutex);
     }
@@ -17,6 +17,7 @@ DLLEXPORT void xml6_gbl_init(void);
 DLLEXPORT void* xml6_gbl_get_external_entity_loader(void);
 DLLEXPORT void xml6_gbl_set_external_entity_loader(void *);
 DLLEXPORT int xml6_gbl_set_external_entity_loader_net(int);
+DLLEXPORT int xml6_gbl_is_default_loading(void);
 
 DLLEXPORT int xml6_gbl_os_thread_get_tag_expansion(void);
 DLLEXPORT void xml6_gbl_os_thread_set_tag_expansion(int);
@@ -24,6 +25,14 @@ DLLEXPORT void xml6_gbl_os_thread_set_tag_expansion(int);
 DLLEXPORT int xml6_gbl_os_thread_get_keep_blanks(void);
 DLLEXPORT void xml6_gbl_os_thread_set_keep_blanks(int flag);
 
+/* flags for xml6_gbl_os_thread_swap_flags() */
+#define XML6_GBL_TAG_EXPANSION 1
+#define XML6_GBL_KEEP_BLANKS 2
+
+DLLEXPORT int xml6_gbl_os_thread_swap_flags(int flags);
+DLLEXPORT int xml6_gbl_is_cwd(const char*);
+DLLEXPORT xmlChar* xml6_gbl_absolute_path(const char*);
+
 DLLEXPORT void xml6_gbl_os_thread_xml_free(void*);
 
 typedef void (*xml6_gbl_MessageCallback) (const char *msg);
@@ -0,0 +1,142 @@
+#include "xml6.h"
+#include "xml6_gc.h"
+#include "xml6_ref.h"
+#include "xml6_ptr_hash.h"
+#include "dom.h"
+#include <libxml/threads.h>
+#include <assert.h>
+
+/* Released node trees. These are either freed immediately, or, if deferred,
+ * queued and freed in batches by xml6_gc_collect().
+ */
+static int _deferred = 0;
+static xml6PtrHashPtr _pending = NULL;
+static xmlMutexPtr _mutex = NULL;
+
+// Called once, from xml6_gbl_init()
+DLLEXPORT void xml6_gc_init(void) {
+    assert(_mutex == NULL);
+    _mutex = xmlNewMutex();
+}
+
+static void _xml6_gc_lock(void) {
+    xmlMutexLock(_mutex);
+}
+
+static void _xml6_gc_unlock(void) {
+    xmlMutexUnlock(_mutex);
+}
+
+static void _xml6_gc_free(xmlNodePtr node) {
+    if (node->type == XML_DOCUMENT_NODE
+        || node->type == XML_HTML_DOCUMENT_NODE
+#ifdef LIBXML_DOCB_ENABLED
+        || node->type == XML_DOCB_DOCUMENT_NODE
+#endif
+        ) {
+        xmlFreeDoc((xmlDocPtr) node);
+    }
+    else {
+        node->_private = xml6_ref_freed();
+        xmlFreeNode(node);
+    }
+}
+
+DLLEXPORT void xml6_gc_set_deferred(int deferred) {
+    _xml6_gc_lock();
+    _deferred = deferred;
+    _xml6_gc_unlock();
+}
+
+DLLEXPORT int xml6_gc_get_deferred(void) {
+    return _deferred;
+}
+
+/**
+ * Name: xml6_gc_release
+ * Synopsis: void xml6_gc_release(xmlNodePtr node);
+ * @node: an unlinked and unreferenced node tree
+ *
+ * Frees the tree, or queues it for the next xml6_gc_collect(), if
+ * deferred.
+ **/
+DLLEXPORT void xml6_gc_release(xmlNodePtr node) {
+    int queued = 0;
+    assert(node != NULL);
+
+    if (_deferred) {
+        _xml6_gc_lock();
+        if (_deferred) {
+            if (_pending == NULL) {
+                _pending = xml6_ptr_hash_new(0);
+            }
+            xml6_ptr_hash_update(_pending, node, node, NULL);
+            queued = 1;
+        }
+        _xml6_gc_unlock();
+    }
+
+    if (!queued) {
+        _xml6_gc_free(node);
+    }
+}
+
+// A queued tree has been referenced again
+DLLEXPORT void xml6_gc_unqueue(xmlNodePtr node) {
+    if (_pending != NULL) {
+        _xml6_gc_lock();
+        if (_pending != NULL) {
+            xml6_ptr_hash_remove(_pending, node, NULL);
+        }
+        _xml6_gc_unlock();
+    }
+}
+
+DLLEXPORT size_t xml6_gc_pending(void) {
+    size_t n;
+    _xml6_gc_lock();
+    n = _pending != NULL ? xml6_ptr_hash_elems(_pending) : 0;
+    _xml6_gc_unlock();
+    return n;
+}
+
+/**
+ * Name: xml6_gc_collect
+ * Synopsis: int xml6_gc_collect(void);
+ *
+ * Frees queued node trees that are still unlinked and unreferenced.
+ * Returns the number of trees freed.
+ **/
+DLLEXPORT int xml6_gc_collect(void) {
+    xml6PtrHashPtr batch;
+    const void** nodes;
+    size_t i, n;
+    int freed = 0;
+
+    _xml6_gc_lock();
+    batch = _pending;
+    _pending = NULL;
+    _xml6_gc_unlock();
+
+    if (batch == NULL) {
+        return 0;
+    }
+
+    n = xml6_ptr_hash_elems(batch);
+    nodes = (const void**) xmlMalloc((n ? n : 1) * sizeof(void*));
+    assert(nodes != NULL);
+    xml6_ptr_hash_keys(batch, nodes);
+    xml6_ptr_hash_free(batch, NULL);
+
+    for (i = 0; i < n; i++) {
+        xmlNodePtr node = (xmlNodePtr) nodes[i];
+        if (node->parent == NULL && node->prev == NULL && node->next == NULL
+            && !domNodeIsReferenced(node)) {
+            _xml6_gc_free(node);
+            freed++;
+        }
+    }
+
+    xmlFree(nodes);
+    return freed;
+}
@@ -0,0 +1,14 @@
+#ifndef __XML6_GC_H
+#define __XML6_GC_H
+
+#include <libxml/tree.h>
+
+DLLEXPORT void xml6_gc_init(void);
+DLLEXPORT void xml6_gc_set_deferred(int);
+DLLEXPORT int xml6_gc_get_deferred(void);
+DLLEXPORT void xml6_gc_release(xmlNodePtr);
+DLLEXPORT void xml6_gc_unqueue(xmlNodePtr);
+DLLEXPORT size_t xml6_gc_pending(void);
+DLLEXPORT int xml6_gc_collect(void);
+
+#endif /* __XML6_GC_H */
@@ -6,6 +6,7 @@
 #include "xml6.h"
 #include "xml6_node.h"
 #include "xml6_hash.h"
+#include "xml6_ns.h"
 #include "dom.h"
 #include "domXPath.h"
 
@@ -63,15 +64,77 @@ DLLEXPORT void xml6_hash_key_values(xmlHashTablePtr self, void** buf) {
     _xml6_scan(self, (xmlHashScannerFull) _xml6_get_pair, 2, buf);
 }
 
+struct _xml6PackedKeys {
+    size_t len;
+    xmlChar* buf;
+    size_t* offsets;
+    size_t n;
+};
+
+static void _xml6_packed_key_len(void* _value, struct _xml6PackedKeys* packed, xmlChar* name, xmlChar* pfx, xmlChar* _) {
+    (void)_value; /* unused parameter */
+    (void)_; /* unused parameter */
+    if (pfx != NULL && *pfx != 0) {
+        packed->len += xmlStrlen(pfx) + 1;
+    }
+    packed->len += xmlStrlen(name) + 1;
+}
+
+static void _xml6_packed_key(void* _value, struct _xml6PackedKeys* packed, xmlChar* name, xmlChar* pfx, xmlChar* _) {
+    xmlChar* p = packed->buf + packed->len;
+    size_t n;
+    (void)_value; /* unused parameter */
+    (void)_; /* unused parameter */
+
+    if (packed->offsets != NULL) {
+        packed->offsets[packed->n] = packed->len;
+    }
+    packed->n++;
+
+    if (pfx != NULL && *pfx != 0) {
+        n = xmlStrlen(pfx);
+        memcpy(p, pfx, n);
+        p += n;
+        *(p++) = ':';
+    }
+    n = xmlStrlen(name) + 1;
+    memcpy(p, name, n);
+    p += n;
+
+    packed->len = p - packed->buf;
+}
+
+// Returns the buffer size needed by xml6_hash_keys_packed()
+DLLEXPORT size_t xml6_hash_keys_packed_len(xmlHashTablePtr self) {
+    struct _xml6PackedKeys packed = { 0, NULL, NULL, 0 };
+    assert(self != NULL);
+    xmlHashScanFull(self, (xmlHashScannerFull) _xml6_packed_key_len, (void*) &packed);
+    return packed.len;
+}
+
+// Writes all keys to a single buffer, as NUL terminated UTF-8 strings, in
+// the same order as xml6_hash_values(). If offsets is not NULL, it should have
+// room for xmlHashSize() + 1 entries. It is set to the start of each key,
+// followed by the total length.
+DLLEXPORT void xml6_hash_keys_packed(xmlHashTablePtr self, xmlChar* buf, size_t* offsets) {
+    struct _xml6PackedKeys packed = { 0, buf, offsets, 0 };
+    assert(self != NULL);
+    assert(buf != NULL || xmlHashSize(self) == 0);
+    xmlHashScanFull(self, (xmlHashScannerFull) _xml6_packed_key, (void*) &packed);
+    if (offsets != NULL) {
+        offsets[packed.n] = packed.len;
+    }
+}
+
 DLLEXPORT int xml6_hash_update_entry_ns(xmlHashTablePtr self, xmlChar* name, void* value, xmlHashDeallocator deallocator) {
-    xmlChar* pfx = NULL;
-    xmlChar* uqname = xmlSplitQName2(name, &pfx);
+    xmlChar buf[XML6_NS_PREFIX_MAX];
+    xmlChar* pfx;
+    const xmlChar* local = xml6_ns_split_qname(name, buf, &pfx);
     int rv = 0;
 
-    if (uqname != NULL) {
-        rv = xmlHashUpdateEntry2(self, uqname, pfx, value, deallocator);
-        xmlFree(uqname);
-        xmlFree(pfx);
+    if (local != NULL) {
+        rv = xmlHashUpdateEntry2(self, local, pfx, value, deallocator);
+        xml6_ns_free_prefix(pfx, buf);
     }
     else {
         rv = xmlHashUpdateEntry(self, name, value, deallocator);
@@ -81,14 +144,14 @@ DLLEXPORT int xml6_hash_update_entry_ns(xmlHashTablePtr self, xmlChar* name, voi
 }
 
 DLLEXPORT int xml6_hash_remove_entry_ns(xmlHashTablePtr self, xmlChar* name, xmlHashDeallocator deallocator) {
-    xmlChar* pfx = NULL;
-    xmlChar* uqname = xmlSplitQName2(name, &pfx);
+    xmlChar buf[XML6_NS_PREFIX_MAX];
+    xmlChar* pfx;
+    const xmlChar* local = xml6_ns_split_qname(name, buf, &pfx);
     int rv = 0;
 
-    if (uqname != NULL) {
-        rv = xmlHashRemoveEntry2(self, uqname, pfx, deallocator);
-        xmlFree(uqname);
-        xmlFree(pfx);
+    if (local != NULL) {
+        rv = xmlHashRemoveEntry2(self, local, pfx, deallocator);
+        xml6_ns_free_prefix(pfx, buf);
     }
     else {
         rv = xmlHashRemoveEntry(self, name, deallocator);
@@ -112,49 +175,89 @@ DLLEXPORT void xml6_hash_add_pairs(xmlHashTablePtr self, void** pairs, unsigned
     }
 }
 
+// Keys returned by domGetXPathKey() are static or interned, and are
+// copied by xmlHashAddEntry(); they don't need to be duplicated here.
+static xmlNodeSetPtr _hash_xpath_bucket(xmlHashTablePtr self, const xmlChar* key) {
+    xmlNodeSetPtr bucket = (xmlNodeSetPtr) xmlHashLookup(self, key);
+
+    if (bucket == NULL) {
+        bucket = xmlXPathNodeSetCreate(NULL);
+        if (xmlHashAddEntry(self, key, (void*) bucket) != 0) {
+            xmlXPathFreeNodeSet(bucket);
+            bucket = NULL;
+        }
+    }
+
+    return bucket;
+}
+
 static void _hash_xpath_node(xmlHashTablePtr self, xmlNodePtr node) {
     assert(self != NULL);
 
     if (node != NULL) {
-        // todo
-        xmlChar* key = xmlStrdup(domGetXPathKey(node));
-        xmlNodeSetPtr bucket = (xmlNodeSetPtr) xmlHashLookup(self, key);
+        const xmlChar* key = domGetXPathKey(node);
+        xmlNodeSetPtr bucket = key ? _hash_xpath_bucket(self, key) : NULL;
 
-        if (bucket == NULL) {
-            bucket = xmlXPathNodeSetCreate(NULL);
-            xmlHashAddEntry(self, key, (void*) bucket);
+        if (bucket != NULL) {
+            domPushNodeSet(bucket, node, 0);
         }
-
-        domPushNodeSet(bucket, node, 0);
     }
 }
 
 static void _hash_xpath_node_siblings(xmlHashTablePtr self, xmlNodePtr node, int keep_blanks) {
+    const xmlChar* prev_key = NULL;
+    xmlNodeSetPtr bucket = NULL;
     assert(self != NULL);
 
-    if (node != NULL) {
-        // todo
-        xmlChar* key = xmlStrdup(domGetXPathKey(node));
-        xmlNodeSetPtr bucket = (xmlNodeSetPtr) xmlHashLookup(self, key);
-        xmlNodePtr next = (node->type == XML_NAMESPACE_DECL)
+    while (node != NULL) {
+        const xmlChar* key = domGetXPathKey(node);
+
+        if (key != NULL) {
+            // runs of like-named siblings share a single lookup
+            if (key != prev_key) {
+                bucket = _hash_xpath_bucket(self, key);
+                prev_key = key;
+            }
+            if (bucket != NULL) {
+                domPushNodeSet(bucket, node, 1);
+            }
+        }
+
+        node = (node->type == XML_NAMESPACE_DECL)
             ? (xmlNodePtr) ((xmlNsPtr) node)->next
             : xml6_node_next(node, keep_blanks);
+    }
+}
 
-        if (bucket == NULL) {
-            bucket = xmlXPathNodeSetCreate(NULL);
-            xmlHashAddEntry(self, key, (void*) bucket);
-        }
+static int _hash_xpath_node_count(xmlNodePtr node) {
+    int n = 0;
+    xmlNodePtr cur;
 
-        domPushNodeSet(bucket, node, 1);
-        xmlFree(key);
+    if (node->type == XML_NAMESPACE_DECL) {
+        return 0;
+    }
 
-        _hash_xpath_node_siblings(self, next, keep_blanks);
+    for (cur = node->children; cur != NULL; cur = cur->next) {
+        n++;
     }
+
+    if (node->type == XML_ELEMENT_NODE) {
+        xmlAttrPtr attr;
+        for (attr = node->properties; attr != NULL; attr = attr->next) {
+            n++;
+        }
+    }
+
+    return n;
 }
 
 static void _hash_xpath_node_children(xmlHashTablePtr self, xmlNodePtr node, int keep_blanks) {
     assert(self != NULL);
 
+    if (node->type == XML_NAMESPACE_DECL) {
+        return;
+    }
+
     _hash_xpath_node_siblings(self, node->children, keep_blanks);
 
     if (node->type == XML_ELEMENT_NODE) {
@@ -163,18 +266,32 @@ static void _hash_xpath_node_children(xmlHashTablePtr self, xmlNodePtr node, int
 }
 
 DLLEXPORT xmlHashTablePtr xml6_hash_xpath_node_children(xmlNodePtr node, int keep_blanks) {
-    xmlHashTablePtr rv = xmlHashCreate(0);
+    xmlHashTablePtr rv = xmlHashCreate(_hash_xpath_node_count(node));
     assert(rv != NULL);
     _hash_xpath_node_children(rv, node, keep_blanks);
     return rv;
 }
 
 DLLEXPORT xmlHashTablePtr xml6_hash_xpath_nodeset(xmlNodeSetPtr nodes, int deref) {
-    xmlHashTablePtr rv = xmlHashCreate(0);
+    xmlHashTablePtr rv;
+    int size = 0;
+    int i;
+
+    if (nodes != NULL) {
+        if (deref) {
+            for (i = 0; i < nodes->nodeNr; i++) {
+                size += _hash_xpath_node_count(nodes->nodeTab[i]);
+            }
+        }
+        else {
+            size = nodes->nodeNr;
+        }
+    }
+
+    rv = xmlHashCreate(size);
     assert(rv != NULL);
 
     if (nodes != NULL) {
-        int i;
         for (i = 0; i < nodes->nodeNr; i++) {
             xmlNodePtr node = nodes->nodeTab[i];
 
@@ -194,15 +311,15 @@ static void _xml6_build_hash_attrs(void* value, const void* _self, xmlChar* attr
     xmlHashTablePtr bucket = (xmlHashTablePtr) xml6_hash_lookup_ns(self, elem_qname);
 
     if (bucket == NULL) {
-        xmlChar* pfx = NULL;
-        xmlChar* uqname = xmlSplitQName2(elem_qname, &pfx);
+        xmlChar buf[XML6_NS_PREFIX_MAX];
+        xmlChar* pfx;
+        const xmlChar* local = xml6_ns_split_qname(elem_qname, buf, &pfx);
         // Vivify sub-hash
         bucket = xmlHashCreate(0);
         assert(bucket != NULL);
-        if (uqname != NULL) {
-            xmlHashAddEntry2(self, uqname, pfx, (void*) bucket);
-            xmlFree(uqname);
-            xmlFree(pfx);
+        if (local != NULL) {
+            xmlHashAddEntry2(self, local, pfx, (void*) bucket);
+            xml6_ns_free_prefix(pfx, buf);
         }
         else {
             xmlHashAddEntry(self, elem_qname, (void*) bucket);
@@ -223,14 +340,14 @@ DLLEXPORT xmlHashTablePtr xml6_hash_build_attr_decls(xmlHashTablePtr self) {
 }
 
 DLLEXPORT void* xml6_hash_lookup_ns(xmlHashTablePtr self, xmlChar* name) {
-    xmlChar* pfx = NULL;
+    xmlChar buf[XML6_NS_PREFIX_MAX];
+    xmlChar* pfx;
+    const xmlChar* local = xml6_ns_split_qname(name, buf, &pfx);
     void* rv = NULL;
-    xmlChar* uqname = xmlSplitQName2(name, &pfx);
 
-    if (uqname != NULL) {
-        rv = xmlHashLookup2(self, uqname, pfx);
-        xmlFree(uqname);
-        xmlFree(pfx);
+    if (local != NULL) {
+        rv = xmlHashLookup2(self, local, pfx);
+        xml6_ns_free_prefix(pfx, buf);
     }
     else {
         rv = xmlHashLookup(self, name);
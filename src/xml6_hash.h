@@ -6,6 +6,8 @@
 DLLEXPORT void xml6_hash_keys(xmlHashTablePtr, void**);
 DLLEXPORT void xml6_hash_values(xmlHashTablePtr, void**);
 DLLEXPORT void xml6_hash_key_values(xmlHashTablePtr, void**);
+DLLEXPORT size_t xml6_hash_keys_packed_len(xmlHashTablePtr);
+DLLEXPORT void xml6_hash_keys_packed(xmlHashTablePtr, xmlChar*, size_t*);
 DLLEXPORT int xml6_hash_update_entry_ns(xmlHashTablePtr, xmlChar*, void*, xmlHashDeallocator);
 DLLEXPORT int xml6_hash_remove_entry_ns(xmlHashTablePtr, xmlChar*, xmlHashDeallocator);
 DLLEXPORT void xml6_hash_add_pairs(xmlHashTablePtr, void**, unsigned int, xmlHashDeallocator);
@@ -1,5 +1,9 @@
 #include "xml6.h"
 #include "xml6_input.h"
+#include <libxml/hash.h>
+#include <libxml/parserInternals.h>
+#include <libxml/threads.h>
+#include <string.h>
 #include <assert.h>
 
 DLLEXPORT void xml6_input_set_filename(xmlParserInputPtr self, char *url) {
@@ -9,14 +13,356 @@ DLLEXPORT void xml6_input_set_filename(xmlParserInputPtr self, char *url) {
 }
 
 DLLEXPORT int xml6_input_buffer_push_str(xmlParserInputBufferPtr buffer, const xmlChar* str) {
-    xmlChar* new_string = NULL;
-    int len;
-
     assert(buffer != NULL);
     assert(str != NULL);
 
-    new_string = xmlStrdup(str);
-    len = xmlStrlen(new_string);
+    // the buffer takes its own copy
+    return xmlParserInputBufferPush(buffer, xmlStrlen(str), (const char*) str);
+}
+
+/**
+ * Name: xml6_input_reader_new
+ * Synopsis: xml6InputReaderPtr xml6_input_reader_new(void* handle, xml6InputFillFunc fill, xmlInputCloseCallback close, int size);
+ * @handle: the opened input
+ * @fill: fills a buffer from the input, returning the number of bytes, 0 at end of input, or -1 on error
+ * @close: closes the input
+ * @size: fill size, or 0 for XML6_INPUT_READ_SIZE
+ *
+ * Creates a buffered input reader. A single buffer of the given size
+ * is allocated up-front and re-filled as it's consumed, so the fill
+ * function is called once per 'size' bytes, rather than on every read
+ * by the parser.
+ **/
+DLLEXPORT xml6InputReaderPtr
+xml6_input_reader_new(void* handle, xml6InputFillFunc fill, xmlInputCloseCallback close, int size) {
+    xml6InputReaderPtr self = (xml6InputReaderPtr) xmlMalloc(sizeof(xml6InputReader));
+    assert(self != NULL);
+    assert(fill != NULL);
+
+    if (size <= 0) size = XML6_INPUT_READ_SIZE;
+
+    memset(self, 0, sizeof(xml6InputReader));
+    self->handle = handle;
+    self->fill = fill;
+    self->close = close;
+    self->size = size;
+    self->buf = (char*) xmlMalloc(size);
+    assert(self->buf != NULL);
+
+    return self;
+}
+
+// read callback (xmlInputReadCallback); serves parser reads from the buffer
+DLLEXPORT int
+xml6_input_reader_read(void* ctx, char* out, int len) {
+    xml6InputReaderPtr self = (xml6InputReaderPtr) ctx;
+    int n;
+
+    if (self == NULL || len < 0) return -1;
+
+    if (self->pos >= self->len) {
+        n = (*self->fill)(self->handle, self->buf, self->size);
+        if (n <= 0) return n < 0 ? -1 : 0;
+        self->pos = 0;
+        self->len = n > self->size ? self->size : n;
+    }
+
+    n = self->len - self->pos;
+    if (n > len) n = len;
+    memcpy(out, self->buf + self->pos, n);
+    self->pos += n;
+
+    return n;
+}
+
+// close callback (xmlInputCloseCallback); closes the input and frees the reader
+DLLEXPORT int
+xml6_input_reader_close(void* ctx) {
+    xml6InputReaderPtr self = (xml6InputReaderPtr) ctx;
+    int rv = 0;
+
+    if (self == NULL) return -1;
+
+    if (self->close != NULL) {
+        rv = (*self->close)(self->handle);
+    }
+    xmlFree(self->buf);
+    xmlFree(self);
+
+    return rv;
+}
+
+static xmlMutexPtr _map_mutex = NULL;
+static int _callbacks_nr = 0;   /* groups registered via xml6_input_register() */
+
+// registers an input callback group, which is counted by xml6_input_has_callbacks()
+DLLEXPORT int
+xml6_input_register(xmlInputMatchCallback match, xmlInputOpenCallback open,
+                    xmlInputReadCallback read, xmlInputCloseCallback close) {
+    int rv = xmlRegisterInputCallbacks(match, open, read, close);
+    if (rv >= 0) {
+        xmlMutexLock(_map_mutex);
+        _callbacks_nr++;
+        xmlMutexUnlock(_map_mutex);
+    }
+    return rv;
+}
+
+// registers an input callback group, whose open callback returns an xml6InputReader
+DLLEXPORT int
+xml6_input_register_reader(xmlInputMatchCallback match, xmlInputOpenCallback open) {
+    return xml6_input_register(match, open, xml6_input_reader_read, xml6_input_reader_close);
+}
+
+// pops the most recently registered input callback group
+DLLEXPORT int xml6_input_pop(void) {
+    int rv = xmlPopInputCallbacks();
+    if (rv >= 0) {
+        xmlMutexLock(_map_mutex);
+        if (_callbacks_nr > 0) _callbacks_nr--;
+        xmlMutexUnlock(_map_mutex);
+    }
+    return rv;
+}
+
+// whether any input callbacks are registered, other than for mapped inputs
+DLLEXPORT int xml6_input_has_callbacks(void) {
+    int rv;
+    xmlMutexLock(_map_mutex);
+    rv = _callbacks_nr > 0;
+    xmlMutexUnlock(_map_mutex);
+    return rv;
+}
+
+/* Natively resolved inputs. URI prefixes may be mapped to directories,
+ * or URIs to in-memory documents. These are resolved by an external entity
+ * loader, which sits beneath any entity cache and ahead of libxml2's
+ * default, or no-network, loader; so mapped URIs are resolved before the
+ * no-network check, and without any callbacks to Raku. */
+
+typedef struct {
+    char* prefix;
+    size_t prefix_len;
+    char* dir;
+} _xml6InputDir;
+
+typedef struct {
+    char* buf;
+    int len;
+} _xml6InputMem;
+
+static _xml6InputDir* _map_dirs = NULL;
+static int _map_dirs_nr = 0;
+static xmlHashTablePtr _map_mems = NULL;
+static xmlExternalEntityLoader _map_next_loader = NULL;
+
+// Called once, from xml6_gbl_init(). Installs xml6_input_map_loader()
+// over the current, default, loader.
+DLLEXPORT void xml6_input_init(void) {
+    assert(_map_mutex == NULL);
+    _map_mutex = xmlNewMutex();
+    _map_next_loader = xmlGetExternalEntityLoader();
+    xmlSetExternalEntityLoader(xml6_input_map_loader);
+}
+
+static void _xml6_input_mem_deallocator(void* payload, const xmlChar* name) {
+    _xml6InputMem* mem = (_xml6InputMem*) payload;
+    (void) name;
+    xmlFree(mem->buf);
+    xmlFree(mem);
+}
+
+// the longest mapped prefix of a URI, or NULL
+static _xml6InputDir* _xml6_input_map_dir_lookup(const char* uri) {
+    _xml6InputDir* found = NULL;
+    int i;
+    for (i = 0; i < _map_dirs_nr; i++) {
+        _xml6InputDir* d = &(_map_dirs[i]);
+        if ((found == NULL || d->prefix_len > found->prefix_len)
+            && strncmp(uri, d->prefix, d->prefix_len) == 0) {
+            found = d;
+        }
+    }
+    return found;
+}
+
+/**
+ * Name: xml6_input_map_dir
+ * Synopsis: int xml6_input_map_dir(const char* prefix, const char* dir);
+ * @prefix: URI prefix, e.g. "http://example.org/schemas/"
+ * @dir: replacement, e.g. "/usr/share/schemas/"
+ *
+ * Resolves URIs starting with prefix by replacing the prefix with dir,
+ * then opening the result as a local file. The longest matching prefix
+ * is used. A directory may not itself start with a mapped prefix
+ * (including its own), as the mapping would then recurse. URIs with
+ * '..' segments after the prefix are not resolved.
+ *
+ * Returns 0 on success, or -1 on failure.
+ **/
+DLLEXPORT int xml6_input_map_dir(const char* prefix, const char* dir) {
+    int rv = -1;
+    int i;
+    assert(_map_mutex != NULL);
+    if (prefix == NULL || *prefix == 0 || dir == NULL) return -1;
+    if (strncmp(dir, prefix, strlen(prefix)) == 0) return -1;
+
+    xmlMutexLock(_map_mutex);
+    for (i = 0; i < _map_dirs_nr; i++) {
+        if (strncmp(dir, _map_dirs[i].prefix, _map_dirs[i].prefix_len) == 0
+            || strncmp(_map_dirs[i].dir, prefix, strlen(prefix)) == 0) {
+            goto done;
+        }
+    }
+    {
+        _xml6InputDir* dirs = (_xml6InputDir*) xmlRealloc(_map_dirs, (_map_dirs_nr + 1) * sizeof(_xml6InputDir));
+        if (dirs != NULL) {
+            _map_dirs = dirs;
+            _map_dirs[_map_dirs_nr].prefix = (char*) xmlStrdup((const xmlChar*) prefix);
+            _map_dirs[_map_dirs_nr].prefix_len = strlen(prefix);
+            _map_dirs[_map_dirs_nr].dir = (char*) xmlStrdup((const xmlChar*) dir);
+            _map_dirs_nr++;
+            rv = 0;
+        }
+    }
+done:
+    xmlMutexUnlock(_map_mutex);
+    return rv;
+}
+
+/**
+ * Name: xml6_input_map_mem
+ * Synopsis: int xml6_input_map_mem(const char* uri, const char* buf, int len);
+ * @uri: the URI
+ * @buf: document content, which is copied
+ * @len: length of buf in bytes
+ *
+ * Resolves the URI to an in-memory document, replacing any previous
+ * mapping of the URI. Inputs that are already open are unaffected.
+ *
+ * Returns 0 on success, or -1 on failure.
+ **/
+DLLEXPORT int xml6_input_map_mem(const char* uri, const char* buf, int len) {
+    _xml6InputMem* mem;
+    int rv = -1;
+    assert(_map_mutex != NULL);
+    if (uri == NULL || (buf == NULL && len > 0) || len < 0) return -1;
+
+    mem = (_xml6InputMem*) xmlMalloc(sizeof(_xml6InputMem));
+    assert(mem != NULL);
+    mem->buf = (char*) xmlMalloc(len ? len : 1);
+    assert(mem->buf != NULL);
+    if (len) memcpy(mem->buf, buf, len);
+    mem->len = len;
+
+    xmlMutexLock(_map_mutex);
+    if (_map_mems == NULL) _map_mems = xmlHashCreate(0);
+    if (xmlHashUpdateEntry(_map_mems, (const xmlChar*) uri, mem, _xml6_input_mem_deallocator) == 0) {
+        rv = 0;
+    }
+    xmlMutexUnlock(_map_mutex);
+
+    if (rv < 0) _xml6_input_mem_deallocator(mem, NULL);
+    return rv;
+}
+
+// Removes all mappings
+DLLEXPORT void xml6_input_map_clear(void) {
+    int i;
+    assert(_map_mutex != NULL);
+    xmlMutexLock(_map_mutex);
+    for (i = 0; i < _map_dirs_nr; i++) {
+        xmlFree(_map_dirs[i].prefix);
+        xmlFree(_map_dirs[i].dir);
+    }
+    if (_map_dirs != NULL) xmlFree(_map_dirs);
+    _map_dirs = NULL;
+    _map_dirs_nr = 0;
+    if (_map_mems != NULL) {
+        xmlHashFree(_map_mems, _xml6_input_mem_deallocator);
+        _map_mems = NULL;
+    }
+    xmlMutexUnlock(_map_mutex);
+}
+
+// whether a relative path has any '..' segments
+static int _xml6_input_has_dotdot(const char* path) {
+    const char* p = path;
+    while ((p = strstr(p, "..")) != NULL) {
+        if ((p == path || p[-1] == '/' || p[-1] == '\\')
+            && (p[2] == 0 || p[2] == '/' || p[2] == '\\')) {
+            return 1;
+        }
+        p += 2;
+    }
+    return 0;
+}
+
+// Opens a mapped URI. The input retains the URI as its filename, so
+// relative references are also resolved via the mapping.
+static xmlParserInputPtr _xml6_input_map_resolve(const char* url, xmlParserCtxtPtr ctxt, int* mapped) {
+    xmlParserInputPtr input = NULL;
+    xmlParserInputBufferPtr in = NULL;
+    _xml6InputMem* mem = NULL;
+    char* path = NULL;
+
+    *mapped = 0;
+    if (url == NULL) return NULL;
+
+    xmlMutexLock(_map_mutex);
+    if (_map_mems != NULL) {
+        mem = (_xml6InputMem*) xmlHashLookup(_map_mems, (const xmlChar*) url);
+    }
+    if (mem != NULL) {
+        *mapped = 1;
+        // takes a copy, so is unaffected by later changes to the mapping
+        in = xmlParserInputBufferCreateMem(mem->buf, mem->len, XML_CHAR_ENCODING_NONE);
+    }
+    else {
+        _xml6InputDir* d = _xml6_input_map_dir_lookup(url);
+        if (d != NULL) {
+            *mapped = 1;
+            if (!_xml6_input_has_dotdot(url + d->prefix_len)) {
+                path = (char*) xmlStrncatNew((const xmlChar*) d->dir, (const xmlChar*) url + d->prefix_len, -1);
+            }
+        }
+    }
+    xmlMutexUnlock(_map_mutex);
+
+    if (in != NULL) {
+        input = xmlNewIOInputStream(ctxt, in, XML_CHAR_ENCODING_NONE);
+        if (input == NULL) xmlFreeParserInputBuffer(in);
+    }
+    else if (path != NULL) {
+        // a local file; libxml2's default I/O handles any decompression
+        if (ctxt != NULL) input = xmlNewInputFromFile(ctxt, path);
+        xmlFree(path);
+    }
+
+    if (input != NULL) xml6_input_set_filename(input, (char*) url);
+    return input;
+}
+
+/**
+ * Name: xml6_input_map_loader
+ * Synopsis: xmlParserInputPtr xml6_input_map_loader(const char* url, const char* id, xmlParserCtxtPtr ctxt);
+ *
+ * External entity loader for mapped inputs. Other URIs are passed on to
+ * libxml2's default loader. xml6_input_map_loader_nonet() instead passes
+ * them on to xmlNoNetExternalEntityLoader().
+ **/
+DLLEXPORT xmlParserInputPtr
+xml6_input_map_loader(const char* url, const char* id, xmlParserCtxtPtr ctxt) {
+    int mapped;
+    xmlParserInputPtr input = _xml6_input_map_resolve(url, ctxt, &mapped);
+    if (mapped) return input;
+    return _map_next_loader ? (*_map_next_loader)(url, id, ctxt) : NULL;
+}
 
-    return xmlParserInputBufferPush(buffer, len, (const char*)new_string);
+DLLEXPORT xmlParserInputPtr
+xml6_input_map_loader_nonet(const char* url, const char* id, xmlParserCtxtPtr ctxt) {
+    int mapped;
+    xmlParserInputPtr input = _xml6_input_map_resolve(url, ctxt, &mapped);
+    if (mapped) return input;
+    return xmlNoNetExternalEntityLoader(url, id, ctxt);
 }
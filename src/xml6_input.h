@@ -8,4 +8,39 @@ DLLEXPORT void xml6_input_set_filename(xmlParserInputPtr, char *url);
 
 DLLEXPORT int xml6_input_buffer_push_str(xmlParserInputBufferPtr, const xmlChar* str);
 
+/* default fill size for input readers */
+#define XML6_INPUT_READ_SIZE 65536
+
+typedef int (*xml6InputFillFunc) (void* handle, char* buf, int len);
+
+/* buffered reader, for input callbacks that fill a native buffer */
+struct _xml6InputReader {
+    void* handle;             /* as returned by the open callback */
+    xml6InputFillFunc fill;
+    xmlInputCloseCallback close;
+    char* buf;                /* reused for each fill */
+    int size;
+    int pos;
+    int len;
+};
+typedef struct _xml6InputReader xml6InputReader;
+typedef xml6InputReader *xml6InputReaderPtr;
+
+DLLEXPORT xml6InputReaderPtr xml6_input_reader_new(void* handle, xml6InputFillFunc fill, xmlInputCloseCallback close, int size);
+DLLEXPORT int xml6_input_reader_read(void* ctx, char* out, int len);
+DLLEXPORT int xml6_input_reader_close(void* ctx);
+DLLEXPORT int xml6_input_register(xmlInputMatchCallback match, xmlInputOpenCallback open,
+                                  xmlInputReadCallback read, xmlInputCloseCallback close);
+DLLEXPORT int xml6_input_register_reader(xmlInputMatchCallback match, xmlInputOpenCallback open);
+DLLEXPORT int xml6_input_pop(void);
+DLLEXPORT int xml6_input_has_callbacks(void);
+
+/* natively resolved inputs; see xml6_input_map_dir(), xml6_input_map_mem() */
+DLLEXPORT void xml6_input_init(void);
+DLLEXPORT int xml6_input_map_dir(const char* prefix, const char* dir);
+DLLEXPORT int xml6_input_map_mem(const char* uri, const char* buf, int len);
+DLLEXPORT void xml6_input_map_clear(void);
+DLLEXPORT xmlParserInputPtr xml6_input_map_loader(const char* url, const char* id, xmlParserCtxtPtr ctxt);
+DLLEXPORT xmlParserInputPtr xml6_input_map_loader_nonet(const char* url, const char* id, xmlParserCtxtPtr ctxt);
+
 #endif /* __XML6_INPUT_H */
@@ -1,20 +1,47 @@
 #include "xml6.h"
 #include "xml6_node.h"
 #include "xml6_ref.h"
+#include "xml6_gc.h"
 #include "libxml/xpathInternals.h"
 #include "libxml/xmlsave.h"
 #include "libxml/c14n.h"
 #include <assert.h>
 #include <stddef.h>
 
+// The node above this one, for the purposes of reference counting.
+// An external subset is counted as a descendant of its document.
+static xmlNodePtr _xml6_node_up(xmlNodePtr self) {
+    if (self->parent == NULL && self->type == XML_DTD_NODE
+        && self->doc != NULL && self->doc->extSubset == (xmlDtdPtr) self) {
+        return (xmlNodePtr) self->doc;
+    }
+    return self->parent;
+}
+
+// Adjust the referenced-descendant counts of each of the node's ancestors
+static void _xml6_node_propagate(xmlNodePtr self, int delta) {
+    xmlNodePtr node;
+    for (node = _xml6_node_up(self); node != NULL; node = _xml6_node_up(node)) {
+        xml6_ref_add_descendants( &(node->_private), delta );
+    }
+}
+
 DLLEXPORT void xml6_node_add_reference(xmlNodePtr self) {
     assert(self != NULL);
     assert(self->type != XML_NAMESPACE_DECL);
     assert(!(self->type == XML_ENTITY_DECL && ((xmlEntityPtr)self)->etype == XML_INTERNAL_PREDEFINED_ENTITY));
-    xml6_ref_add( &(self->_private) );
+    if (self->_private == NULL) {
+        // it may have been released, but not yet freed
+        xml6_gc_unqueue(self);
+    }
+    if (xml6_ref_add( &(self->_private) )) {
+        _xml6_node_propagate(self, 1);
+    }
 }
 
 DLLEXPORT int xml6_node_remove_reference(xmlNodePtr self) {
+    int released;
+    int referenced;
     assert(self != NULL);
     assert(self->type != XML_NAMESPACE_DECL);
     assert(!(self->type == XML_ENTITY_DECL && ((xmlEntityPtr)self)->etype == XML_INTERNAL_PREDEFINED_ENTITY));
@@ -22,7 +49,57 @@ DLLEXPORT int xml6_node_remove_reference(xmlNodePtr self) {
         /* unexpected; print some extra debugging */
         fprintf(stderr, __FILE__ ":%d %p type=%d name='%s'\n", __LINE__, self, self->type, (self->name ? (char*) self->name : "(null)"));
     }
-    return xml6_ref_remove( &(self->_private), "node", (void*) self);
+    referenced = self->_private != NULL;
+    released = xml6_ref_remove( &(self->_private), "node", (void*) self);
+    if (released && referenced) {
+        _xml6_node_propagate(self, -1);
+    }
+    return released;
+}
+
+/**
+ * Name: xml6_node_refs_detach
+ * Synopsis: void xml6_node_refs_detach(xmlNodePtr self);
+ * @self: a node that is about to be unlinked
+ *
+ * Removes any referenced nodes in the subtree from the counts of its
+ * ancestors. This should be called, while the node is still linked, by
+ * anything that unlinks it. See also xml6_node_refs_attach().
+ **/
+DLLEXPORT void xml6_node_refs_detach(xmlNodePtr self) {
+    int refs;
+    if (self == NULL || self->type == XML_NAMESPACE_DECL) return;
+    refs = xml6_ref_get_subtree_refs(self->_private);
+    if (refs) _xml6_node_propagate(self, -refs);
+}
+
+/**
+ * Name: xml6_node_refs_attach
+ * Synopsis: void xml6_node_refs_attach(xmlNodePtr self);
+ * @self: a node that has just been linked
+ *
+ * Adds any referenced nodes in the subtree to the counts of its new
+ * ancestors.
+ **/
+DLLEXPORT void xml6_node_refs_attach(xmlNodePtr self) {
+    int refs;
+    if (self == NULL || self->type == XML_NAMESPACE_DECL) return;
+    refs = xml6_ref_get_subtree_refs(self->_private);
+    if (refs) _xml6_node_propagate(self, refs);
+}
+
+// Cache slot of the node's Raku wrapper, or 0. Only referenced nodes
+// may be cached, as the slot is stored with the reference count.
+DLLEXPORT int xml6_node_get_box_id(xmlNodePtr self) {
+    assert(self != NULL);
+    if (self->type == XML_NAMESPACE_DECL) return 0;
+    return xml6_ref_get_box_id(self->_private);
+}
+
+DLLEXPORT int xml6_node_set_box_id(xmlNodePtr self, int box_id) {
+    assert(self != NULL);
+    if (self->type == XML_NAMESPACE_DECL) return 0;
+    return xml6_ref_set_box_id(self->_private, box_id);
 }
 
 DLLEXPORT int xml6_node_lock(xmlNodePtr self) {
@@ -104,6 +181,60 @@ DLLEXPORT xmlNodePtr xml6_node_prev(xmlNodePtr node, int keep_blanks) {
     return node;
 }
 
+// Adds a reference to an item that is about to be boxed. Namespaces are
+// copied when boxed, and predefined entities are static, so are skipped.
+// Returns 1 if a reference was added, 0 otherwise.
+DLLEXPORT int xml6_node_item_reference(xmlNodePtr item) {
+    assert(item != NULL);
+    if (item->type == XML_NAMESPACE_DECL
+        || (item->type == XML_ENTITY_DECL && ((xmlEntityPtr)item)->etype == XML_INTERNAL_PREDEFINED_ENTITY)) {
+        return 0;
+    }
+    xml6_node_add_reference(item);
+    return 1;
+}
+
+/**
+ * Name: xml6_node_items
+ * Synopsis: int xml6_node_items(xmlNodePtr node, int keep_blanks, int max, xmlNodePtr* items, int* types, int reference);
+ * @node: first item; a node, attribute or namespace
+ * @keep_blanks: include blank text nodes
+ * @max: maximum number of items to return
+ * @items: output buffer of at least max items
+ * @types: output buffer of at least max node types
+ * @reference: add a reference to each returned node
+ *
+ * Fetches a block of sibling items, starting with node, for bulk
+ * iteration and boxing. Returns the number of items fetched.
+ **/
+DLLEXPORT int xml6_node_items(xmlNodePtr node, int keep_blanks, int max, xmlNodePtr* items, int* types, int reference) {
+    int n = 0;
+    assert(items != NULL);
+    assert(types != NULL);
+
+    if (node != NULL && keep_blanks == 0 && node->type != XML_NAMESPACE_DECL && xmlIsBlankNode(node)) {
+        node = xml6_node_next(node, keep_blanks);
+    }
+
+    while (node != NULL && n < max) {
+        items[n] = node;
+        types[n] = node->type;
+        n++;
+        if (reference) xml6_node_item_reference(node);
+
+        if (node->type == XML_NAMESPACE_DECL) {
+            // a namespace list; stop at an owner element back-pointer
+            xmlNsPtr next = ((xmlNsPtr) node)->next;
+            node = (next != NULL && next->type == XML_NAMESPACE_DECL) ? (xmlNodePtr) next : NULL;
+        }
+        else {
+            node = xml6_node_next(node, keep_blanks);
+        }
+    }
+
+    return n;
+}
+
 DLLEXPORT void xml6_node_set_doc(xmlNodePtr self, xmlDocPtr doc) {
     assert(self != NULL);
     if (self->doc && self->doc != doc) xml6_warn("possible memory leak in setting node->doc");
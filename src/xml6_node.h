@@ -7,6 +7,10 @@
 
 DLLEXPORT void xml6_node_add_reference(xmlNodePtr);
 DLLEXPORT int xml6_node_remove_reference(xmlNodePtr);
+DLLEXPORT void xml6_node_refs_detach(xmlNodePtr);
+DLLEXPORT void xml6_node_refs_attach(xmlNodePtr);
+DLLEXPORT int xml6_node_get_box_id(xmlNodePtr);
+DLLEXPORT int xml6_node_set_box_id(xmlNodePtr, int);
 DLLEXPORT int xml6_node_lock(xmlNodePtr);
 DLLEXPORT int xml6_node_unlock(xmlNodePtr);
 
@@ -15,6 +19,8 @@ DLLEXPORT xmlNodePtr xml6_node_first_child(xmlNodePtr, int);
 DLLEXPORT xmlNodePtr xml6_node_last_child(xmlNodePtr, int);
 DLLEXPORT xmlNodePtr xml6_node_next(xmlNodePtr, int);
 DLLEXPORT xmlNodePtr xml6_node_prev(xmlNodePtr, int);
+DLLEXPORT int xml6_node_item_reference(xmlNodePtr);
+DLLEXPORT int xml6_node_items(xmlNodePtr, int, int, xmlNodePtr*, int*, int);
 DLLEXPORT void xml6_node_set_doc(xmlNodePtr, xmlDocPtr);
 DLLEXPORT void xml6_node_set_ns(xmlNodePtr, xmlNsPtr);
 DLLEXPORT void xml6_node_set_nsDef(xmlNodePtr, xmlNsPtr);
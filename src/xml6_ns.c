@@ -31,3 +31,42 @@ DLLEXPORT const xmlChar* xml6_ns_unique_key(xmlNsPtr self) {
     if (self->href != NULL) rv = xmlStrcat(rv, self->href);
     return xml6_gbl_dict(rv);
 }
+
+// Split a QName, as per xmlSplitQName2(). Returns the local name, which
+// points into 'name', and sets '*pfx' to a copy of the prefix in 'buf', of
+// size XML6_NS_PREFIX_MAX (heap allocated for long prefixes). Returns NULL
+// if 'name' is unprefixed, or the prefix or local name is empty.
+DLLEXPORT const xmlChar* xml6_ns_split_qname(const xmlChar* name, xmlChar* buf, xmlChar** pfx) {
+    const xmlChar* colon;
+    size_t len;
+
+    *pfx = NULL;
+
+    if (name == NULL || name[0] == ':') {
+        return NULL;
+    }
+
+    colon = xmlStrchr(name, ':');
+    if (colon == NULL || colon[1] == 0) {
+        return NULL;
+    }
+
+    len = colon - name;
+    if (len < XML6_NS_PREFIX_MAX) {
+        memcpy(buf, name, len);
+        buf[len] = 0;
+        *pfx = buf;
+    }
+    else {
+        *pfx = xmlStrndup(name, len);
+    }
+
+    return colon + 1;
+}
+
+// Frees a prefix returned by xml6_ns_split_qname(), if heap allocated
+DLLEXPORT void xml6_ns_free_prefix(xmlChar* pfx, const xmlChar* buf) {
+    if (pfx != NULL && pfx != buf) {
+        xmlFree(pfx);
+    }
+}
@@ -6,4 +6,10 @@
 DLLEXPORT xmlNsPtr xml6_ns_copy(xmlNsPtr);
 DLLEXPORT const xmlChar* xml6_ns_unique_key(xmlNsPtr);
 
+/* prefixes up to this length are split without heap allocation */
+#define XML6_NS_PREFIX_MAX 64
+
+DLLEXPORT const xmlChar* xml6_ns_split_qname(const xmlChar* name, xmlChar* buf, xmlChar** pfx);
+DLLEXPORT void xml6_ns_free_prefix(xmlChar* pfx, const xmlChar* buf);
+
 #endif /* __XML6_NS_H */
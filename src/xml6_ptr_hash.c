@@ -0,0 +1,200 @@
+#include "xml6.h"
+#include "xml6_ptr_hash.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+/* Linear probing, with backward-shift deletion, so there are no
+ * tombstones. The table is kept at most 3/4 full.
+ */
+#define XML6_PTR_HASH_MIN 16
+
+static size_t _xml6_ptr_hash_slot(xml6PtrHashPtr self, const void* key) {
+    uintptr_t h = (uintptr_t) key;
+    // nodes are aligned; fold and scramble the address bits
+    h ^= h >> 16;
+    h *= (uintptr_t) 0x45d9f3b;
+    h ^= h >> 16;
+    return (size_t) h & (self->size - 1);
+}
+
+static xml6PtrHashEntry* _xml6_ptr_hash_find(xml6PtrHashPtr self, const void* key) {
+    size_t i = _xml6_ptr_hash_slot(self, key);
+
+    for (;;) {
+        xml6PtrHashEntry* entry = &(self->slots[i]);
+        if (entry->key == key || entry->key == NULL) {
+            return entry;
+        }
+        i = (i + 1) & (self->size - 1);
+    }
+}
+
+static void _xml6_ptr_hash_resize(xml6PtrHashPtr self, size_t size) {
+    xml6PtrHashEntry* old = self->slots;
+    size_t old_size = self->size;
+    size_t i;
+
+    self->slots = (xml6PtrHashEntry*) xmlMalloc(size * sizeof(xml6PtrHashEntry));
+    assert(self->slots != NULL);
+    memset(self->slots, 0, size * sizeof(xml6PtrHashEntry));
+    self->size = size;
+
+    for (i = 0; i < old_size; i++) {
+        if (old[i].key != NULL) {
+            *(_xml6_ptr_hash_find(self, old[i].key)) = old[i];
+        }
+    }
+
+    if (old != NULL) {
+        xmlFree(old);
+    }
+}
+
+DLLEXPORT xml6PtrHashPtr xml6_ptr_hash_new(size_t elems) {
+    xml6PtrHashPtr self = (xml6PtrHashPtr) xmlMalloc(sizeof(xml6PtrHash));
+    size_t size = XML6_PTR_HASH_MIN;
+    assert(self != NULL);
+
+    while (size - size / 4 < elems) {
+        size *= 2;
+    }
+
+    memset(self, 0, sizeof(xml6PtrHash));
+    _xml6_ptr_hash_resize(self, size);
+
+    return self;
+}
+
+DLLEXPORT void xml6_ptr_hash_free(xml6PtrHashPtr self, xmlHashDeallocator deallocator) {
+    if (self != NULL) {
+        if (deallocator != NULL) {
+            size_t i;
+            for (i = 0; i < self->size; i++) {
+                if (self->slots[i].key != NULL) {
+                    deallocator(self->slots[i].value, NULL);
+                }
+            }
+        }
+        xmlFree(self->slots);
+        xmlFree(self);
+    }
+}
+
+DLLEXPORT size_t xml6_ptr_hash_elems(xml6PtrHashPtr self) {
+    assert(self != NULL);
+    return self->elems;
+}
+
+DLLEXPORT void* xml6_ptr_hash_lookup(xml6PtrHashPtr self, const void* key) {
+    assert(self != NULL);
+    return key ? _xml6_ptr_hash_find(self, key)->value : NULL;
+}
+
+DLLEXPORT int xml6_ptr_hash_exists(xml6PtrHashPtr self, const void* key) {
+    assert(self != NULL);
+    return key ? _xml6_ptr_hash_find(self, key)->key != NULL : 0;
+}
+
+// Returns 1 if a new entry was added, 0 if an existing entry was updated, or -1 on error
+DLLEXPORT int xml6_ptr_hash_update(xml6PtrHashPtr self, const void* key, void* value, xmlHashDeallocator deallocator) {
+    xml6PtrHashEntry* entry;
+    assert(self != NULL);
+
+    if (key == NULL) {
+        return -1;
+    }
+
+    entry = _xml6_ptr_hash_find(self, key);
+
+    if (entry->key != NULL) {
+        if (deallocator != NULL && entry->value != value) {
+            deallocator(entry->value, NULL);
+        }
+        entry->value = value;
+        return 0;
+    }
+
+    if (self->elems + 1 > self->size - self->size / 4) {
+        _xml6_ptr_hash_resize(self, self->size * 2);
+        entry = _xml6_ptr_hash_find(self, key);
+    }
+
+    entry->key = key;
+    entry->value = value;
+    self->elems++;
+
+    return 1;
+}
+
+// Returns 1 if the entry was removed, 0 if it was not found
+DLLEXPORT int xml6_ptr_hash_remove(xml6PtrHashPtr self, const void* key, xmlHashDeallocator deallocator) {
+    size_t mask, i, j;
+    assert(self != NULL);
+
+    if (key == NULL) {
+        return 0;
+    }
+
+    mask = self->size - 1;
+    i = _xml6_ptr_hash_find(self, key) - self->slots;
+
+    if (self->slots[i].key == NULL) {
+        return 0;
+    }
+
+    if (deallocator != NULL) {
+        deallocator(self->slots[i].value, NULL);
+    }
+
+    // shift back any following entries that were displaced past this slot
+    for (j = (i + 1) & mask; self->slots[j].key != NULL; j = (j + 1) & mask) {
+        size_t home = _xml6_ptr_hash_slot(self, self->slots[j].key);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            self->slots[i] = self->slots[j];
+            i = j;
+        }
+    }
+    self->slots[i].key = NULL;
+    self->slots[i].value = NULL;
+    self->elems--;
+
+    return 1;
+}
+
+DLLEXPORT void xml6_ptr_hash_keys(xml6PtrHashPtr self, const void** buf) {
+    size_t i;
+    assert(self != NULL);
+    assert(buf != NULL);
+
+    for (i = 0; i < self->size; i++) {
+        if (self->slots[i].key != NULL) {
+            *(buf++) = self->slots[i].key;
+        }
+    }
+}
+
+DLLEXPORT void xml6_ptr_hash_values(xml6PtrHashPtr self, void** buf) {
+    size_t i;
+    assert(self != NULL);
+    assert(buf != NULL);
+
+    for (i = 0; i < self->size; i++) {
+        if (self->slots[i].key != NULL) {
+            *(buf++) = self->slots[i].value;
+        }
+    }
+}
+
+DLLEXPORT void xml6_ptr_hash_key_values(xml6PtrHashPtr self, void** buf) {
+    size_t i;
+    assert(self != NULL);
+    assert(buf != NULL);
+
+    for (i = 0; i < self->size; i++) {
+        if (self->slots[i].key != NULL) {
+            *(buf++) = (void*) self->slots[i].key;
+            *(buf++) = self->slots[i].value;
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef __XML6_PTR_HASH_H
+#define __XML6_PTR_HASH_H
+
+#include <libxml/hash.h>
+#include <libxml/xmlmemory.h>
+
+/* open addressing hash table, keyed by pointer identity */
+
+struct _xml6PtrHashEntry {
+    const void* key;
+    void* value;
+};
+typedef struct _xml6PtrHashEntry xml6PtrHashEntry;
+
+struct _xml6PtrHash {
+    size_t size;             /* number of slots; a power of two */
+    size_t elems;            /* number of occupied slots */
+    xml6PtrHashEntry* slots;
+};
+typedef struct _xml6PtrHash xml6PtrHash;
+typedef xml6PtrHash *xml6PtrHashPtr;
+
+DLLEXPORT xml6PtrHashPtr xml6_ptr_hash_new(size_t);
+DLLEXPORT void xml6_ptr_hash_free(xml6PtrHashPtr, xmlHashDeallocator);
+DLLEXPORT size_t xml6_ptr_hash_elems(xml6PtrHashPtr);
+DLLEXPORT void* xml6_ptr_hash_lookup(xml6PtrHashPtr, const void*);
+DLLEXPORT int xml6_ptr_hash_exists(xml6PtrHashPtr, const void*);
+DLLEXPORT int xml6_ptr_hash_update(xml6PtrHashPtr, const void*, void*, xmlHashDeallocator);
+DLLEXPORT int xml6_ptr_hash_remove(xml6PtrHashPtr, const void*, xmlHashDeallocator);
+DLLEXPORT void xml6_ptr_hash_keys(xml6PtrHashPtr, const void**);
+DLLEXPORT void xml6_ptr_hash_values(xml6PtrHashPtr, void**);
+DLLEXPORT void xml6_ptr_hash_key_values(xml6PtrHashPtr, void**);
+
+#endif /* __XML6_PTR_HASH_H */
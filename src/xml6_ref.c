@@ -2,20 +2,23 @@
 #include "xml6_ref.h"
 #include "libxml/threads.h"
 #include <string.h>
+#include <assert.h>
 
 struct _xml6Ref {
     xmlChar *fail;
     xmlMutexPtr mutex;
     int ref_count;
     int flags;
+    int box_id;    /* slot of the cached Raku wrapper, if any */
     int magic;     /* for verification */
+    int descendants; /* referenced nodes below this one */
 };
 
 typedef struct _xml6Ref xml6Ref;
 typedef xml6Ref *xml6RefPtr;
 
 static xml6Ref ref_freed = {
-    NULL, NULL, 0, 0, 0
+    NULL, NULL, 0, 0, 0, 0, 0
 };
 
 static xmlMutexPtr _mutex = NULL;
@@ -25,62 +28,99 @@ static int ref_current = 0;
 static int ref_total = 0;
 #endif
 
+DLLEXPORT void xml6_ref_init(void) {
+    assert(_mutex == NULL);
+    _mutex = xmlNewMutex();
+}
+
 DLLEXPORT void* xml6_ref_freed() {
     return (void *) &ref_freed;
 }
 
 static xml6RefPtr
-_ref_new(void) {
+_ref_new(int ref_count) {
     xml6RefPtr ref = (xml6RefPtr)xmlMalloc(sizeof(struct _xml6Ref));
     memset(ref, 0, sizeof(struct _xml6Ref));
     ref->magic = XML6_REF_MAGIC;
     ref->mutex = xmlNewMutex();
-    ref->ref_count = 1;
+    ref->ref_count = ref_count;
     return ref;
 }
 
-DLLEXPORT void
-xml6_ref_add(void** self_ptr) {
-    xml6RefPtr self;
+// attach a new reference, unless one has been attached concurrently
+static int
+_ref_init(void** self_ptr, int ref_count) {
     int init = 0;
 
-    if (_mutex == NULL) {
-        _mutex = xmlNewMutex();
-    }
-
+    xmlMutexLock(_mutex);
     if ( *self_ptr == NULL ) {
-        xmlMutexLock(_mutex);
-        if ( *self_ptr == NULL ) {
-            self = _ref_new();
-            *self_ptr = (void*) self;
+        *self_ptr = (void*) _ref_new(ref_count);
 #ifdef DEBUG
-            ref_current++;
-            ref_total++;
+        ref_current++;
+        ref_total++;
 #endif
-            init = 1;
-        }
-        xmlMutexUnlock(_mutex);
+        init = 1;
     }
+    xmlMutexUnlock(_mutex);
 
-    if (!init) {
-        self = (xml6RefPtr) *self_ptr;
+    return init;
+}
 
-        if (self->magic != XML6_REF_MAGIC) {
-            char msg[80];
-            if (self == &ref_freed) {
-                sprintf(msg, "%p has previously been freed", self);
-            }
-            else {
-                sprintf(msg, "%p is not owned by us, or is corrupted", self);
-            }
-            xml6_warn(msg);
+static int
+_ref_check(xml6RefPtr self) {
+    if (self->magic != XML6_REF_MAGIC) {
+        char msg[80];
+        if (self == &ref_freed) {
+            sprintf(msg, "%p has previously been freed", self);
         }
         else {
-            xmlMutexLock(self->mutex);
-            self->ref_count++;
-            xmlMutexUnlock(self->mutex);
+            sprintf(msg, "%p is not owned by us, or is corrupted", self);
         }
+        xml6_warn(msg);
+        return 0;
+    }
+    return 1;
+}
+
+// free a reference that is no longer in use; called with its mutex held
+static void
+_ref_free(void** self_ptr, const char* name, void *obj) {
+    xml6RefPtr self = (xml6RefPtr) *self_ptr;
+
+    if (self->fail != NULL) {
+        char msg[120];
+        snprintf(msg, sizeof(msg), "uncaught failure on %s %p destruction: %s", name, obj, self->fail);
+        xml6_warn(msg);
+        xmlFree(self->fail);
     }
+    *self_ptr = NULL;
+    xmlFree((void*) self);
+#ifdef DEBUG
+    xmlMutexLock(_mutex);
+    ref_current--;
+    xmlMutexUnlock(_mutex);
+#endif
+}
+
+// Adds a reference. Returns 1 if this is the first direct reference
+DLLEXPORT int
+xml6_ref_add(void** self_ptr) {
+    xml6RefPtr self;
+    int first = 0;
+
+    if ( *self_ptr == NULL && _ref_init(self_ptr, 1) ) {
+        return 1;
+    }
+
+    self = (xml6RefPtr) *self_ptr;
+
+    if (_ref_check(self)) {
+        xmlMutexLock(self->mutex);
+        first = self->ref_count++ == 0;
+        xmlMutexUnlock(self->mutex);
+    }
+
+    return first;
 }
 
 DLLEXPORT int
@@ -109,19 +149,15 @@ xml6_ref_remove(void** self_ptr, const char* name, void *obj) {
             }
             else {
                 if (self->ref_count == 1) {
-                    if (self->fail != NULL) {
-                        snprintf(msg, sizeof(msg), "uncaught failure on %s %p destruction: %s", name, obj, self->fail);
-                        xml6_warn(msg);
-                        xmlFree(self->fail);
+                    if (self->descendants > 0) {
+                        // retained, to count referenced descendants
+                        self->ref_count = 0;
+                        self->box_id = 0;
+                    }
+                    else {
+                        _ref_free(self_ptr, name, obj);
+                        self = NULL;
                     }
-                    *self_ptr = NULL;
-                    xmlFree((void*) self);
-                    self = NULL;
-#ifdef DEBUG
-                    xmlMutexLock(_mutex);
-                    ref_current--;
-                    xmlMutexUnlock(_mutex);
-#endif
                     released = 1;
                 }
                 else {
@@ -141,6 +177,64 @@ xml6_ref_remove(void** self_ptr, const char* name, void *obj) {
     return released;
 }
 
+/**
+ * Name: xml6_ref_add_descendants
+ * Synopsis: void xml6_ref_add_descendants(void** self_ptr, int delta);
+ * @self_ptr: address of the owner's reference
+ * @delta: change in the number of referenced descendants
+ *
+ * Maintains a count of referenced nodes below a node. The reference is
+ * retained while either the node itself, or any of its descendants are
+ * referenced.
+ **/
+DLLEXPORT void
+xml6_ref_add_descendants(void** self_ptr, int delta) {
+    xml6RefPtr self;
+    xmlMutexPtr mutex;
+
+    if (delta == 0) return;
+
+    if (*self_ptr == NULL) {
+        if (delta < 0) {
+            xml6_warn("descendant references were not counted");
+            return;
+        }
+        _ref_init(self_ptr, 0);
+    }
+
+    self = (xml6RefPtr) *self_ptr;
+    if (!_ref_check(self)) return;
+
+    mutex = self->mutex;
+    xmlMutexLock(mutex);
+    self->descendants += delta;
+    if (self->descendants < 0) {
+        xml6_warn("descendant references were not counted");
+        self->descendants = 0;
+    }
+    if (self->descendants == 0 && self->ref_count == 0) {
+        _ref_free(self_ptr, "node", NULL);
+        self = NULL;
+    }
+    xmlMutexUnlock(mutex);
+
+    if (self == NULL) {
+        xmlFreeMutex(mutex);
+    }
+}
+
+// Number of referenced nodes in the owner's subtree, including itself
+DLLEXPORT int
+xml6_ref_get_subtree_refs(void* _self) {
+    xml6RefPtr self = (xml6RefPtr) _self;
+    if (self != NULL && self->magic == XML6_REF_MAGIC) {
+        return (self->ref_count > 0) + self->descendants;
+    }
+    else {
+        return 0;
+    }
+}
+
 DLLEXPORT void
 xml6_ref_set_fail(void* _self, xmlChar* fail) {
     xml6RefPtr self = (xml6RefPtr) _self;
@@ -188,6 +282,19 @@ xml6_ref_set_flags(void* _self, int flags) {
     }
 }
 
+// Sets, then clears, flag bits atomically. Returns the new flags
+DLLEXPORT int
+xml6_ref_update_flags(void* _self, int set, int clear) {
+    xml6RefPtr self = (xml6RefPtr) _self;
+    int flags = 0;
+    if (self != NULL && self->magic == XML6_REF_MAGIC) {
+        xmlMutexLock(self->mutex);
+        flags = self->flags = (self->flags | set) & ~clear;
+        xmlMutexUnlock(self->mutex);
+    }
+    return flags;
+}
+
 DLLEXPORT int
 xml6_ref_get_flags(void* _self) {
     xml6RefPtr self = (xml6RefPtr) _self;
@@ -199,6 +306,31 @@ xml6_ref_get_flags(void* _self) {
     }
 }
 
+DLLEXPORT int
+xml6_ref_set_box_id(void* _self, int box_id) {
+    xml6RefPtr self = (xml6RefPtr) _self;
+    if (self != NULL && self->magic == XML6_REF_MAGIC) {
+        xmlMutexLock(self->mutex);
+        self->box_id = box_id;
+        xmlMutexUnlock(self->mutex);
+        return 1;
+    }
+    else {
+        return 0;
+    }
+}
+
+DLLEXPORT int
+xml6_ref_get_box_id(void* _self) {
+    xml6RefPtr self = (xml6RefPtr) _self;
+    if (self != NULL && self->magic == XML6_REF_MAGIC) {
+        return self->box_id;
+    }
+    else {
+        return 0;
+    }
+}
+
 DLLEXPORT int
 xml6_ref_lock(void* _self) {
     xml6RefPtr self = (xml6RefPtr) _self;
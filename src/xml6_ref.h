@@ -8,12 +8,18 @@
 #define XML6_FAIL(self, msg) { self && self->_private ? xml6_ref_set_fail(self->_private, (xmlChar*)msg) : xml6_warn(msg); return NULL;}
 #define XML6_FAIL_i(self, msg) {self && self->_private ? xml6_ref_set_fail(self->_private, (xmlChar*)msg) : xml6_warn(msg); return -1;}
 
-DLLEXPORT void xml6_ref_add(void**);
+DLLEXPORT void xml6_ref_init(void);
+DLLEXPORT int xml6_ref_add(void**);
 DLLEXPORT int xml6_ref_remove(void**, const char*, void*);
+DLLEXPORT void xml6_ref_add_descendants(void**, int);
+DLLEXPORT int xml6_ref_get_subtree_refs(void*);
 DLLEXPORT void xml6_ref_set_fail(void*, xmlChar*);
 DLLEXPORT xmlChar* xml6_ref_get_fail(void*);
 DLLEXPORT int xml6_ref_set_flags(void*, int);
+DLLEXPORT int xml6_ref_update_flags(void*, int, int);
 DLLEXPORT int xml6_ref_get_flags(void*);
+DLLEXPORT int xml6_ref_set_box_id(void*, int);
+DLLEXPORT int xml6_ref_get_box_id(void*);
 DLLEXPORT int xml6_ref_lock(void*);
 DLLEXPORT int xml6_ref_unlock(void*);
 DLLEXPORT void* xml6_ref_freed();
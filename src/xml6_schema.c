@@ -0,0 +1,500 @@
+#include "xml6.h"
+#include "xml6_schema.h"
+#include "xml6_gbl.h"
+#include "xml6_ptr_hash.h"
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+#include <libxml/xmlschemas.h>
+#include <libxml/relaxng.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/* Compiled schemas are read-only during validation, so may be shared
+ * between threads; validation contexts may not. Each registered schema
+ * has an entry holding a reference count and a pool of idle validation
+ * contexts. Cached schemas hold an additional reference from the cache,
+ * which is keyed by type and absolute location, or content hash. Schemas
+ * aren't cached while input callbacks or a custom entity loader are in
+ * place, as these may resolve imports and includes differently.
+ */
+
+typedef struct {
+    void* schema;
+    int type;
+    int refs;
+    xmlChar* key;            /* cache key, if cached */
+    int pool_elems;
+    void* pool[XML6_SCHEMA_POOL_MAX];
+} _xml6SchemaEntry;
+
+static xmlMutexPtr _schema_mutex = NULL;
+static xmlHashTablePtr _schema_cache = NULL;  /* key -> entry */
+static xml6PtrHashPtr _schema_entries = NULL; /* schema -> entry */
+
+DLLEXPORT void xml6_schema_init(void) {
+    assert(_schema_mutex == NULL);
+    _schema_mutex = xmlNewMutex();
+    _schema_cache = xmlHashCreate(0);
+    _schema_entries = xml6_ptr_hash_new(0);
+}
+
+static void* _xml6_schema_valid_ctxt_new(_xml6SchemaEntry* entry) {
+    return entry->type == XML6_SCHEMA_RNG
+        ? (void*) xmlRelaxNGNewValidCtxt((xmlRelaxNGPtr) entry->schema)
+        : (void*) xmlSchemaNewValidCtxt((xmlSchemaPtr) entry->schema);
+}
+
+static void _xml6_schema_valid_ctxt_free(_xml6SchemaEntry* entry, void* vctxt) {
+    if (entry->type == XML6_SCHEMA_RNG) {
+        xmlRelaxNGFreeValidCtxt((xmlRelaxNGValidCtxtPtr) vctxt);
+    }
+    else {
+        xmlSchemaFreeValidCtxt((xmlSchemaValidCtxtPtr) vctxt);
+    }
+}
+
+// called with the mutex held
+static void _xml6_schema_entry_release(_xml6SchemaEntry* entry) {
+    if (--(entry->refs) == 0) {
+        int i;
+        assert(entry->key == NULL);
+        for (i = 0; i < entry->pool_elems; i++) {
+            _xml6_schema_valid_ctxt_free(entry, entry->pool[i]);
+        }
+        xml6_ptr_hash_remove(_schema_entries, entry->schema, NULL);
+        if (entry->type == XML6_SCHEMA_RNG) {
+            xmlRelaxNGFree((xmlRelaxNGPtr) entry->schema);
+        }
+        else {
+            xmlSchemaFree((xmlSchemaPtr) entry->schema);
+        }
+        xmlFree(entry);
+    }
+}
+
+// called with the mutex held
+static _xml6SchemaEntry* _xml6_schema_entry(void* schema, int type) {
+    _xml6SchemaEntry* entry = (_xml6SchemaEntry*) xml6_ptr_hash_lookup(_schema_entries, schema);
+
+    if (entry == NULL) {
+        entry = (_xml6SchemaEntry*) xmlMalloc(sizeof(_xml6SchemaEntry));
+        assert(entry != NULL);
+        memset(entry, 0, sizeof(_xml6SchemaEntry));
+        entry->schema = schema;
+        entry->type = type;
+        xml6_ptr_hash_update(_schema_entries, schema, entry, NULL);
+    }
+    assert(entry->type == type);
+
+    return entry;
+}
+
+// cache key; either "<type>:<absolute-url>" or "<type>#<fnv-1a hash>:<length>",
+// or NULL if the schema shouldn't be cached
+static xmlChar* _xml6_schema_key(int type, const char* url, const char* buf, int len) {
+    char hdr[64];
+
+    if (!xml6_gbl_is_default_loading()) return NULL;
+
+    if (url != NULL) {
+        xmlChar* path = xml6_gbl_absolute_path(url);
+        xmlChar* key;
+        if (path == NULL) return NULL;
+        snprintf(hdr, sizeof(hdr), "%d:", type);
+        key = xmlStrncatNew((const xmlChar*) hdr, path, -1);
+        xmlFree(path);
+        return key;
+    }
+    else if (buf != NULL && len >= 0) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        int i;
+        for (i = 0; i < len; i++) {
+            h ^= (unsigned char) buf[i];
+            h *= 0x100000001b3ULL;
+        }
+        snprintf(hdr, sizeof(hdr), "%d#%016llx:%d", type, (unsigned long long) h, len);
+        return xmlStrdup((const xmlChar*) hdr);
+    }
+
+    return NULL;
+}
+
+/**
+ * Name: xml6_schema_reference
+ * Synopsis: void* xml6_schema_reference(void* schema, int type);
+ * @schema: a compiled xmlSchemaPtr or xmlRelaxNGPtr
+ * @type: XML6_SCHEMA_XSD or XML6_SCHEMA_RNG
+ *
+ * Registers a schema, or adds a reference to a registered schema.
+ * The schema is freed by the final call to xml6_schema_release().
+ *
+ * Returns the schema
+ **/
+DLLEXPORT void* xml6_schema_reference(void* schema, int type) {
+    assert(schema != NULL);
+    xmlMutexLock(_schema_mutex);
+    _xml6_schema_entry(schema, type)->refs++;
+    xmlMutexUnlock(_schema_mutex);
+    return schema;
+}
+
+DLLEXPORT void xml6_schema_release(void* schema) {
+    _xml6SchemaEntry* entry;
+    assert(schema != NULL);
+    xmlMutexLock(_schema_mutex);
+    entry = (_xml6SchemaEntry*) xml6_ptr_hash_lookup(_schema_entries, schema);
+    assert(entry != NULL);
+    _xml6_schema_entry_release(entry);
+    xmlMutexUnlock(_schema_mutex);
+}
+
+// Returns a referenced, cached schema, or NULL
+DLLEXPORT void* xml6_schema_cache_lookup(int type, const char* url, const char* buf, int len) {
+    xmlChar* key = _xml6_schema_key(type, url, buf, len);
+    _xml6SchemaEntry* entry;
+
+    if (key == NULL) return NULL;
+
+    xmlMutexLock(_schema_mutex);
+    entry = (_xml6SchemaEntry*) xmlHashLookup(_schema_cache, key);
+    if (entry != NULL) entry->refs++;
+    xmlMutexUnlock(_schema_mutex);
+
+    xmlFree(key);
+    return entry ? entry->schema : NULL;
+}
+
+/**
+ * Name: xml6_schema_cache_add
+ * Synopsis: void* xml6_schema_cache_add(void* schema, int type, const char* url, const char* buf, int len);
+ * @schema: a newly compiled schema
+ * @type: XML6_SCHEMA_XSD or XML6_SCHEMA_RNG
+ * @url: schema location, or NULL
+ * @buf: schema content, if url is NULL
+ * @len: content length in bytes
+ *
+ * Registers and caches a newly compiled schema. If another thread has
+ * cached the same schema in the meantime, the new schema is freed and
+ * the cached schema is used instead.
+ *
+ * Returns the referenced schema
+ **/
+DLLEXPORT void* xml6_schema_cache_add(void* schema, int type, const char* url, const char* buf, int len) {
+    xmlChar* key = _xml6_schema_key(type, url, buf, len);
+    _xml6SchemaEntry* entry;
+    void* rv = schema;
+
+    assert(schema != NULL);
+    if (key == NULL) return xml6_schema_reference(schema, type);
+
+    xmlMutexLock(_schema_mutex);
+    entry = (_xml6SchemaEntry*) xmlHashLookup(_schema_cache, key);
+    if (entry != NULL) {
+        entry->refs++;
+        rv = entry->schema;
+        // discard our copy, which is surplus
+        entry = _xml6_schema_entry(schema, type);
+        entry->refs = 1;
+        _xml6_schema_entry_release(entry);
+        xmlFree(key);
+    }
+    else {
+        entry = _xml6_schema_entry(schema, type);
+        entry->refs += 2; // caller's and the cache's
+        entry->key = key;
+        xmlHashAddEntry(_schema_cache, key, entry);
+    }
+    xmlMutexUnlock(_schema_mutex);
+
+    return rv;
+}
+
+DLLEXPORT int xml6_schema_cache_elems(void) {
+    int elems;
+    xmlMutexLock(_schema_mutex);
+    elems = xmlHashSize(_schema_cache);
+    xmlMutexUnlock(_schema_mutex);
+    return elems;
+}
+
+static void _xml6_schema_uncache(void* payload, const xmlChar* name) {
+    _xml6SchemaEntry* entry = (_xml6SchemaEntry*) payload;
+    (void) name;
+    xmlFree(entry->key);
+    entry->key = NULL;
+    _xml6_schema_entry_release(entry);
+}
+
+// Drops the cache's references. Schemas that are still in use are retained until released
+DLLEXPORT void xml6_schema_cache_clear(void) {
+    xmlMutexLock(_schema_mutex);
+    xmlHashFree(_schema_cache, _xml6_schema_uncache);
+    _schema_cache = xmlHashCreate(0);
+    xmlMutexUnlock(_schema_mutex);
+}
+
+/**
+ * Name: xml6_schema_valid_ctxt_acquire
+ * Synopsis: void* xml6_schema_valid_ctxt_acquire(void* schema);
+ * @schema: a registered schema
+ *
+ * Takes an idle validation context from the schema's pool, or creates
+ * a new one. The context also holds a reference to the schema, and should
+ * be returned via xml6_schema_valid_ctxt_release().
+ *
+ * Returns an xmlSchemaValidCtxtPtr or xmlRelaxNGValidCtxtPtr, or NULL
+ **/
+DLLEXPORT void* xml6_schema_valid_ctxt_acquire(void* schema) {
+    _xml6SchemaEntry* entry;
+    void* vctxt = NULL;
+
+    assert(schema != NULL);
+    xmlMutexLock(_schema_mutex);
+    entry = (_xml6SchemaEntry*) xml6_ptr_hash_lookup(_schema_entries, schema);
+    assert(entry != NULL);
+    if (entry->pool_elems > 0) {
+        vctxt = entry->pool[--(entry->pool_elems)];
+    }
+    entry->refs++;
+    xmlMutexUnlock(_schema_mutex);
+
+    if (vctxt == NULL) {
+        // created outside of the lock; the entry is held by our reference
+        vctxt = _xml6_schema_valid_ctxt_new(entry);
+        if (vctxt == NULL) xml6_schema_release(schema);
+    }
+
+    return vctxt;
+}
+
+DLLEXPORT void xml6_schema_valid_ctxt_release(void* schema, void* vctxt) {
+    _xml6SchemaEntry* entry;
+
+    assert(schema != NULL);
+    assert(vctxt != NULL);
+
+    xmlMutexLock(_schema_mutex);
+    entry = (_xml6SchemaEntry*) xml6_ptr_hash_lookup(_schema_entries, schema);
+    assert(entry != NULL);
+
+    if (entry->pool_elems < XML6_SCHEMA_POOL_MAX) {
+        // reset per-use settings
+        if (entry->type == XML6_SCHEMA_RNG) {
+            xmlRelaxNGSetValidStructuredErrors((xmlRelaxNGValidCtxtPtr) vctxt, NULL, NULL);
+        }
+        else {
+            xmlSchemaSetValidStructuredErrors((xmlSchemaValidCtxtPtr) vctxt, NULL, NULL);
+            xmlSchemaSetValidOptions((xmlSchemaValidCtxtPtr) vctxt, 0);
+            xmlSchemaValidateSetLocator((xmlSchemaValidCtxtPtr) vctxt, NULL, NULL);
+        }
+        entry->pool[entry->pool_elems++] = vctxt;
+    }
+    else {
+        _xml6_schema_valid_ctxt_free(entry, vctxt);
+    }
+
+    _xml6_schema_entry_release(entry);
+    xmlMutexUnlock(_schema_mutex);
+}
+
+static int _xml6_schema_ctxt_locator(void* ctx, const char** file, unsigned long* line) {
+    xmlParserCtxtPtr ctxt = (xmlParserCtxtPtr) ctx;
+    if (ctxt->input == NULL) return -1;
+    if (file != NULL) *file = ctxt->input->filename;
+    if (line != NULL) *line = ctxt->input->line;
+    return 0;
+}
+
+/**
+ * Name: xml6_schema_sax_plug
+ * Synopsis: xmlSchemaSAXPlugPtr xml6_schema_sax_plug(xmlSchemaValidCtxtPtr vctxt, xmlParserCtxtPtr ctxt);
+ * @vctxt: an XSD validation context
+ * @ctxt: a parser context, typically a push parser, that has not started parsing
+ *
+ * Plugs schema validation into the parser's SAX callbacks, so the document
+ * is validated as it is parsed. Validation errors are reported via the
+ * parser's error handler, if any. The parser must be unplugged, via
+ * xml6_schema_sax_unplug(), before it is freed.
+ *
+ * Returns the plug, or NULL on failure
+ **/
+DLLEXPORT xmlSchemaSAXPlugPtr xml6_schema_sax_plug(xmlSchemaValidCtxtPtr vctxt, xmlParserCtxtPtr ctxt) {
+    xmlSchemaSAXPlugPtr plug;
+
+    assert(vctxt != NULL);
+    assert(ctxt != NULL);
+
+    plug = xmlSchemaSAXPlug(vctxt, &(ctxt->sax), &(ctxt->userData));
+    if (plug != NULL) {
+        xmlSchemaValidateSetLocator(vctxt, _xml6_schema_ctxt_locator, ctxt);
+#if LIBXML_VERSION >= 21300
+        if (ctxt->errorHandler != NULL) {
+            xmlSchemaSetValidStructuredErrors(vctxt, ctxt->errorHandler, ctxt->errorCtxt);
+        }
+#endif
+    }
+
+    return plug;
+}
+
+// Unplugs validation; returns 1 if the document was valid, 0 if not, or -1 on error
+DLLEXPORT int xml6_schema_sax_unplug(xmlSchemaValidCtxtPtr vctxt, xmlSchemaSAXPlugPtr plug) {
+    int valid;
+    assert(plug != NULL);
+    assert(vctxt != NULL);
+
+    valid = xmlSchemaIsValid(vctxt);
+    xmlSchemaSAXUnplug(plug);
+    xmlSchemaValidateSetLocator(vctxt, NULL, NULL);
+
+    return valid;
+}
+
+/* batch validation */
+
+typedef struct {
+    void* schema;
+    xmlDocPtr* docs;
+    int n;
+    int next;                /* next document to validate */
+    int* results;
+    xml6ErrorRingPtr* rings;
+    xmlMutexPtr mutex;
+} _xml6SchemaBatch;
+
+// discards errors for documents without an error ring
+static void _xml6_schema_batch_quiet(void* ctx, xml6ConstErrorPtr err) {
+    (void) ctx;
+    (void) err;
+}
+
+static void _xml6_schema_batch_work(_xml6SchemaBatch* batch) {
+    _xml6SchemaEntry* entry;
+    void* vctxt = xml6_schema_valid_ctxt_acquire(batch->schema);
+    xml6ErrorRingPtr ring;
+    xmlStructuredErrorFunc handler;
+    int i;
+
+    xmlMutexLock(_schema_mutex);
+    entry = (_xml6SchemaEntry*) xml6_ptr_hash_lookup(_schema_entries, batch->schema);
+    xmlMutexUnlock(_schema_mutex);
+
+    for (;;) {
+        xmlMutexLock(batch->mutex);
+        i = batch->next < batch->n ? batch->next++ : -1;
+        xmlMutexUnlock(batch->mutex);
+        if (i < 0) break;
+
+        ring = batch->rings ? batch->rings[i] : NULL;
+        handler = ring ? xml6_error_ring_handler : _xml6_schema_batch_quiet;
+
+        if (vctxt == NULL || batch->docs[i] == NULL) {
+            batch->results[i] = -1;
+        }
+        else if (entry->type == XML6_SCHEMA_RNG) {
+            xmlRelaxNGSetValidStructuredErrors((xmlRelaxNGValidCtxtPtr) vctxt, handler, ring);
+            batch->results[i] = xmlRelaxNGValidateDoc((xmlRelaxNGValidCtxtPtr) vctxt, batch->docs[i]);
+        }
+        else {
+            xmlSchemaSetValidStructuredErrors((xmlSchemaValidCtxtPtr) vctxt, handler, ring);
+            batch->results[i] = xmlSchemaValidateDoc((xmlSchemaValidCtxtPtr) vctxt, batch->docs[i]);
+        }
+    }
+
+    if (vctxt != NULL) {
+        xml6_schema_valid_ctxt_release(batch->schema, vctxt);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI _xml6_schema_batch_thread(LPVOID arg) {
+    _xml6_schema_batch_work((_xml6SchemaBatch*) arg);
+    return 0;
+}
+#else
+static void* _xml6_schema_batch_thread(void* arg) {
+    _xml6_schema_batch_work((_xml6SchemaBatch*) arg);
+    return NULL;
+}
+#endif
+
+/**
+ * Name: xml6_schema_validate_many
+ * Synopsis: int xml6_schema_validate_many(void* schema, xmlDocPtr* docs, int n, int workers, int* results, xml6ErrorRingPtr* rings);
+ * @schema: a registered schema
+ * @docs: documents to validate; these must be distinct, and not modified during validation
+ * @n: number of documents
+ * @workers: maximum number of threads
+ * @results: output; validation result for each document: 0 if valid, > 0 if invalid, or -1 on error
+ * @rings: optional; error ring for each document
+ *
+ * Validates documents concurrently. Each worker thread takes a validation
+ * context from the schema's pool and validates documents until there are
+ * none left. The calling thread also acts as a worker.
+ *
+ * Returns the number of valid documents
+ **/
+DLLEXPORT int xml6_schema_validate_many(void* schema, xmlDocPtr* docs, int n, int workers, int* results, xml6ErrorRingPtr* rings) {
+    _xml6SchemaBatch batch;
+#ifdef _WIN32
+    HANDLE* threads;
+#else
+    pthread_t* threads;
+#endif
+    int i, started = 0, valid = 0;
+
+    assert(schema != NULL);
+    assert(docs != NULL || n == 0);
+    assert(results != NULL || n == 0);
+
+    if (workers > n) workers = n;
+    if (workers < 1) workers = 1;
+
+    batch.schema = schema;
+    batch.docs = docs;
+    batch.n = n;
+    batch.next = 0;
+    batch.results = results;
+    batch.rings = rings;
+    batch.mutex = xmlNewMutex();
+
+    threads = xmlMalloc(workers * sizeof(*threads));
+    assert(threads != NULL);
+
+    for (i = 1; i < workers; i++) {
+#ifdef _WIN32
+        threads[started] = CreateThread(NULL, 0, _xml6_schema_batch_thread, &batch, 0, NULL);
+        if (threads[started] == NULL) break;
+#else
+        if (pthread_create(&threads[started], NULL, _xml6_schema_batch_thread, &batch) != 0) break;
+#endif
+        started++;
+    }
+
+    _xml6_schema_batch_work(&batch);
+
+    for (i = 0; i < started; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+
+    xmlFree(threads);
+    xmlFreeMutex(batch.mutex);
+
+    for (i = 0; i < n; i++) {
+        if (results[i] == 0) valid++;
+    }
+
+    return valid;
+}
@@ -0,0 +1,35 @@
+#ifndef __XML6_SCHEMA_H
+#define __XML6_SCHEMA_H
+
+#include <libxml/parser.h>
+#include <libxml/xmlschemas.h>
+#include "xml6_error.h"
+
+/* compiled schema cache and validation context pooling */
+
+/* schema types */
+#define XML6_SCHEMA_XSD 0
+#define XML6_SCHEMA_RNG 1
+
+/* maximum idle validation contexts, per schema */
+#define XML6_SCHEMA_POOL_MAX 16
+
+DLLEXPORT void xml6_schema_init(void);
+
+DLLEXPORT void* xml6_schema_reference(void* schema, int type);
+DLLEXPORT void xml6_schema_release(void* schema);
+
+DLLEXPORT void* xml6_schema_cache_lookup(int type, const char* url, const char* buf, int len);
+DLLEXPORT void* xml6_schema_cache_add(void* schema, int type, const char* url, const char* buf, int len);
+DLLEXPORT int xml6_schema_cache_elems(void);
+DLLEXPORT void xml6_schema_cache_clear(void);
+
+DLLEXPORT void* xml6_schema_valid_ctxt_acquire(void* schema);
+DLLEXPORT void xml6_schema_valid_ctxt_release(void* schema, void* vctxt);
+
+DLLEXPORT xmlSchemaSAXPlugPtr xml6_schema_sax_plug(xmlSchemaValidCtxtPtr vctxt, xmlParserCtxtPtr ctxt);
+DLLEXPORT int xml6_schema_sax_unplug(xmlSchemaValidCtxtPtr vctxt, xmlSchemaSAXPlugPtr plug);
+
+DLLEXPORT int xml6_schema_validate_many(void* schema, xmlDocPtr* docs, int n, int workers, int* results, xml6ErrorRingPtr* rings);
+
+#endif /* __XML6_SCHEMA_H */
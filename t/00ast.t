@@ -8,7 +8,7 @@ use LibXML::Item :&ast-to-xml;
 use LibXML::Config;
 use LibXML::Raw;
 
-plan 13;
+plan 14;
 
 LibXML::Config.keep-blanks = False; # Make it the test default
 my LibXML::Element $elem .= new('Test', config => LibXML::Config.new);
@@ -71,4 +71,26 @@ is-deeply $doc.root.ast, "Foo" => [:bar<x>, :bar[:bar<bar>]];
 
 is $doc.ast.&ast-to-xml().Str, $string;
 
+subtest 'native construction', {
+    my $ast = 'mam:legs' => [
+        'xmlns:mam' => 'urn:mammals', :xmlns<urn:camels>,
+        'mam:n' => '4',
+        '#cdata' => 'a&b', '?pi' => 'x', :species['Camelid'], '&foo' => [],
+    ];
+    my LibXML::Element:D $legs = ast-to-xml($ast);
+    is $legs.Str, '<mam:legs xmlns:mam="urn:mammals" xmlns="urn:camels" mam:n="4"><![CDATA[a&b]]><?pi x?><species>Camelid</species>&foo;</mam:legs>';
+    is $legs.localname, 'legs';
+    is $legs.namespaceURI, 'urn:mammals';
+    is $legs.properties[0].namespaceURI, 'urn:mammals';
+    is $legs.children[2].namespaceURI, 'urn:camels';
+    is-deeply $legs.ast, $ast;
+
+    my LibXML::Element:D $herd = ast-to-xml(:herd[ :species['Llama'], LibXML::Element.new('wild'), :species['Alpaca'] ]);
+    is $herd.Str, '<herd><species>Llama</species><wild/><species>Alpaca</species></herd>', 'mixed with an existing node';
+
+    my LibXML::Document $doc .= new;
+    my LibXML::Element:D $owned = $doc.ast-to-xml(:species['Vicuna']);
+    ok $owned.ownerDocument.isSameNode($doc), 'constructed within a document';
+}
+
 done-testing;
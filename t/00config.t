@@ -1,5 +1,5 @@
 use Test;
-plan 5;
+plan 7;
 use LibXML::Config;
 
 subtest 'scoping', {
@@ -90,4 +90,51 @@ subtest 'node', {
     ok $str.starts-with("<?xml"), 'Str with config :!skip';
 }
 
+subtest 'native-inputs', {
+    use LibXML::Document;
+    LibXML::Config.native-inputs = %(
+        'http://example.org/samples/' => 'samples'.IO,
+        'mem:doc.xml' => '<doc><a/></doc>'.encode,
+    );
+    is-deeply LibXML::Config.native-inputs.keys.sort, ('http://example.org/samples/', 'mem:doc.xml'), 'native-inputs';
+
+    my LibXML::Document $doc .= parse: :file<mem:doc.xml>;
+    is $doc.root.tag, 'doc', 'in-memory input';
+
+    $doc .= parse: :file<http://example.org/samples/test.xml>, :expand-xinclude;
+    is $doc.root.tag, 'x', 'mapped directory';
+    ok $doc.first('//xsl'), 'mapped directory, relative include';
+
+    LibXML::Config.native-inputs = %();
+    dies-ok { LibXML::Document.parse: :file<mem:doc.xml> }, 'cleared';
+}
+
+subtest 'entity-cache', {
+    use LibXML::Document;
+    LibXML::Config.entity-cache-size = 100_000;
+    LibXML::Config.entity-cache-check-mtime = True;
+    LibXML::Config.entity-cache-clear;
+
+    my LibXML::Document $doc .= parse: :file<test/dtd/note-external-dtd.xml>, :dtd;
+    ok $doc.getExternalSubset.defined, 'dtd loaded';
+    $doc .= parse: :file<test/dtd/note-external-dtd.xml>, :dtd;
+    ok $doc.getExternalSubset.defined, 'dtd loaded from cache';
+
+    given LibXML::Config.entity-cache-stats {
+        is .<entries>, 1, 'entries';
+        is .<misses>, 1, 'misses';
+        is .<hits>, 1, 'hits';
+    }
+
+    my $string = '<!DOCTYPE r SYSTEM "mem:e.dtd"><r>&e;</r>';
+    LibXML::Config.native-inputs = %( 'mem:e.dtd' => '<!ENTITY e "A">'.encode );
+    is LibXML::Document.parse(:$string, :load-ext-dtd, :expand-entities).root.textContent, 'A', 'mapped dtd';
+    LibXML::Config.native-inputs = %( 'mem:e.dtd' => '<!ENTITY e "B">'.encode );
+    is LibXML::Document.parse(:$string, :load-ext-dtd, :expand-entities).root.textContent, 'B', 'native-inputs clears the cache';
+    LibXML::Config.native-inputs = %();
+
+    LibXML::Config.entity-cache-size = 0;
+    is LibXML::Config.entity-cache-stats<entries>, 0, 'disabled';
+}
+
 done-testing;
@@ -1,6 +1,6 @@
 use v6;
 use Test;
-plan 70;
+plan 79;
 # bootstrapping tests for the DOM
 
 use LibXML;
@@ -8,6 +8,7 @@ use LibXML::Element;
 use LibXML::Document;
 use LibXML::DocumentFragment;
 use LibXML::Raw;
+use LibXML::Config;
 use LibXML::Node;
 use NativeCall;
 use W3C::DOM::Test;
@@ -46,6 +47,32 @@ ok $a.first('b').getOwner.isSameNode($doc);
 $a.unbindNode;
 ok $a.getOwner.isSameNode($a);
 ok $a.first('b').getOwner.isSameNode($a);
+{
+    # references to deep descendants of an unreferenced tree
+    my LibXML::Document $big = $parser.parse: :string('<r>' ~ ('<a><b/></a>' x 200) ~ '</r>');
+    my anyNode $copy = $big.documentElement.raw.copy(:deep);
+    nok $copy.is-referenced, 'copied tree is unreferenced';
+    my anyNode $leaf = $copy.last-child(0).first-child(0);
+    $leaf.Reference;
+    ok $copy.is-referenced, 'deep reference is found';
+    ok $copy.first-child(0).is-referenced, 'sibling reference is found';
+    nok $copy.first-child(0).first-child(0).is-referenced, 'unrelated subtree is unreferenced';
+    $leaf.Unreference;
+}
+
+{
+    # deferred release of node trees
+    LibXML::Config.deferred-release = True;
+    my anyNode $copy = $a.raw.copy(:deep);
+    $copy.Reference;
+    $copy.Unreference;
+    ok LibXML::Config.collect-pending >= 1, 'release is deferred';
+    ok LibXML::Config.collect >= 1, 'collect';
+    LibXML::Config.deferred-release = False;
+    nok LibXML::Config.deferred-release, 'deferred-release reset';
+    is LibXML::Config.collect-pending, 0, 'nothing pending';
+}
+
 lives-ok {$a.validate}, 'validate elem without Dtd';
 ok $a.is-valid, 'is-valid elem without Dtd';
 
@@ -132,6 +159,7 @@ is $prefix, '_ns0', 'first generated NS prefix';
 $elem.requireNamespace('http://ns2');
 $prefix = $elem.raw.genNsPrefix;
 is $prefix, '_ns1', 'second generated NS prefix';
+is $elem.raw.genNsPrefix('x'), 'x0', 'generated NS prefix, with base';
 
 my $elem-xpath-ctxt = $elem.xpath-context;
 $elem.setNamespace('http://ns', 'x', :!activate);
@@ -1,13 +1,15 @@
 use v6;
 use Test;
 use LibXML::HashMap;
+use LibXML::Node::Map;
+use LibXML::Document;
 use LibXML::Element;
 use LibXML::Enums;
 use LibXML::Config;
 use LibXML::Types :XPathRange;
 use NativeCall;
 
-plan 2;
+plan 3;
 
 subtest 'node-hash' => {
     plan 4;
@@ -28,7 +30,7 @@ subtest 'node-hash' => {
 }
 
 subtest 'object-hash' => {
-    plan 20;
+    plan 24;
 
     my $config = LibXML::Config.new;
     my LibXML::HashMap[XPathRange] $h .= new(:$config);
@@ -53,6 +55,18 @@ subtest 'object-hash' => {
     is-deeply $h.values.sort, (42e0, "xx");
     is-deeply $h.pairs.sort, (Xx => 42e0, 'x:y' => "xx");
 
+    is-deeply $h.kv.sort, ("Xx", "x:y", 42e0, "xx").sort, 'kv';
+
+    $h<nöde> = 'ü';
+    is-deeply $h.keys.sort, ("Xx", "nöde", "x:y"), 'UTF-8 keys';
+    $h<nöde>:delete;
+
+    my $long-key = ('p' x 100) ~ ':q';
+    $h{$long-key} = 'long';
+    is $h{$long-key}, 'long', 'long prefix';
+    $h{$long-key}:delete;
+    nok $h{$long-key}:exists, 'long prefix deletion';
+
     my LibXML::Element $node .= new('test', :$config);
 
     lives-ok {$h<elem> = $node;};
@@ -61,4 +75,25 @@ subtest 'object-hash' => {
     ok $h<elem>.isSame($node);
 }
 
+subtest 'node-keyed' => {
+    plan 9;
+    my $config = LibXML::Config.new;
+    my LibXML::Document $doc .= parse: :string('<a><b/><c/><b/></a>'), :$config;
+    my LibXML::Node::Map[UInt] $h .= new(:$config);
+    for $doc.findnodes('//*').list.kv -> $i, $node {
+        $h{$node} = $i;
+    }
+    is $h.elems, 4;
+    my ($b1, $b2) = $doc.findnodes('//b');
+    is $h{$b1}, 1;
+    is $h{$b2}, 3, 'keyed by identity, not name';
+    ok $h{$doc.documentElement}:exists, 'zero value exists';
+    is-deeply $h{$doc.documentElement}, 0;
+    nok $h{LibXML::Element.new('b', :$config)}:exists;
+    $h{$b1}:delete;
+    is $h.elems, 3;
+    nok $h{$b1}:exists;
+    is-deeply $h.keys.map(*.nodeName).sort, ("a", "b", "c");
+}
+
 done-testing;
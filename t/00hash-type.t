@@ -10,10 +10,12 @@ use NativeCall;
 plan 4;
 
 subtest 'Str HashMaps' => {
-    plan 17;
+    plan 19;
     my LibXML::HashMap[Str] $h .= new;
     is-deeply $h.of, Str;
     is $h.elems, 0;
+    is-deeply $h.keys.List, (), 'empty keys';
+    is-deeply $h.Hash, %(), 'empty Hash';
     lives-ok {$h<Xx> = 'Hi'};
     is $h.elems, 1;
     is $h<Xx>, 'Hi';
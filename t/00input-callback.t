@@ -8,7 +8,7 @@ use LibXML;
 use LibXML::InputCallback;
 use LibXML::Config;
 
-plan 19;
+plan 21;
 
 my $fh;
 my %seen;
@@ -51,6 +51,30 @@ lives-ok {$dom = $parser.parse: :file("samples/test.xml")}, 'file parse';
 check-seen();
 is $dom.documentElement.firstChild.name, '#text', 'DOM sanity';
 
+# buffered reading, via a native fill callback
+{
+    my Blob $blob = ('<r>' ~ ('<a/>' x 5000) ~ '</r>').encode;
+    my UInt $fills = 0;
+    my LibXML::InputCallback $buffered .= new: :callbacks{
+        :match(-> $f { $f.starts-with('gen:') }),
+        :open(-> $f { my UInt $pos = 0 }),
+        :fill(-> $pos is rw, CArray[uint8] $buf, UInt $n {
+            $fills++;
+            my $len = min($n, $blob.bytes - $pos);
+            $buf[$_] = $blob[$pos + $_] for ^$len;
+            $pos += $len;
+            $len;
+        }),
+        :close(-> $ {}),
+        :read-size(8192),
+    };
+    LibXML::Config.input-callbacks = $buffered;
+    my $doc = $parser.parse: :file<gen:doc.xml>;
+    is $doc.findvalue('count(/r/a)'), 5000, 'buffered input';
+    ok $fills < 10, 'buffered input is filled in large chunks';
+    LibXML::Config.input-callbacks = $input-callbacks;
+}
+
 done-testing;
 
 sub check-seen {
@@ -2,7 +2,7 @@ use Test;
 use LibXML::Document;
 use LibXML::Config;
 
-plan 4;
+plan 5;
 
 my $xml = q:to<XML>;
     <root>
@@ -46,3 +46,23 @@ subtest 'equivalence', {
     ok @nodes1.head eqv @nodes2.head;
     ok @nodes1.tail eqv @nodes2.tail;
 }
+
+subtest 'eviction and stats', {
+    my LibXML::Config $config .= new: :with-cache, :cache-size(10);
+    my LibXML::Document $doc .= parse: :string('<r>' ~ ('<a/>' x 50) ~ '</r>'), :$config;
+    my $root = $doc.root;
+    ok $root === $doc.root, 'root re-used';
+    my %stats = $config.cache-stats;
+    ok %stats<hits> >= 1, 'hits';
+    my @kids = $root.children;
+    is +@kids, 50;
+    %stats = $config.cache-stats;
+    ok %stats<elems> <= 11, 'cache is bounded';
+    ok %stats<evictions> > 0, 'evictions';
+    ok 0 < %stats<hit-rate> < 1, 'hit-rate';
+    ok @kids.tail === $root.lastChild, 'recent node re-used';
+    is $root.children.elems, 50, 'evicted nodes re-boxed';
+    $config.clear-cache;
+    is $config.cache-stats<elems>, 0, 'clear-cache';
+    nok $root === $doc.root, 'cache cleared';
+}
@@ -371,6 +371,30 @@ subtest 'push parser', {
 
     }
 
+    subtest 'native buffer chunks', {
+        use LibXML::PushParser;
+        use NativeCall;
+        my LibXML::PushParser $push-parser .= new: :chunk("<foo>");
+        my buf8 $buf .= new: "bar</foo>trailing".encode;
+        $push-parser.push: $buf, :size(9);
+        my LibXML::Document:D $doc = $push-parser.finish-push;
+        is $doc.documentElement.Str, '<foo>bar</foo>', 'blob :size prefix';
+
+        $push-parser .= new: :chunk("<foo>");
+        my CArray[uint8] $native .= new: "baz".encode.list;
+        $push-parser.push: $native;
+        $native[$_] = "</foo>".encode[$_] for ^3;
+        $push-parser.push: $native, :size(3);
+        $push-parser.push: nativecast(Pointer, CArray[uint8].new: "oo>".encode.list), :size(3);
+        $doc = $push-parser.finish-push;
+        is $doc.documentElement.Str, '<foo>baz</foo>', 'reused native buffer';
+
+        $push-parser .= new: :chunk("<foo>");
+        throws-like { $push-parser.push: $native, :size(4) }, X::AdHoc, :message(/'exceeds the buffer length'/), 'oversized native :size';
+        throws-like { $push-parser.push: $buf, :size(100) }, X::AdHoc, :message(/'exceeds the buffer length'/), 'oversized blob :size';
+        throws-like { $push-parser.push: nativecast(Pointer, $native), :size(2**31) }, X::AdHoc, :message(/'exceeds the maximum'/), 'size overflows int32';
+    }
+
     subtest 'recovering push parser', {
         $parser.init-push;
 
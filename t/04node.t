@@ -426,6 +426,22 @@ subtest 'importing and adopting', {
     $xnode2.setOwnerDocument( $doc3 ); # alternate version of adopt node
     ok $xnode2.ownerDocument, 'setOwnerDocument';
     ok $doc3.isSameNode( $xnode2.ownerDocument ), 'setOwnerDocument';
+
+    my LibXML::Document $src .= parse: :string('<r xmlns:a="urn:a"><a:x a:att="1"/>text<a:y/></r>');
+    my @kids = $src.documentElement.childNodes;
+    my @copies = $doc3.importNodes(@kids);
+    is +@copies, 3, 'importNodes';
+    ok @copies.map(*.ownerDocument.isSameNode($doc3)).all.so, 'importNodes owner';
+    is @copies[0].Str, '<a:x xmlns:a="urn:a" a:att="1"/>', 'importNodes namespaces';
+    is $src.documentElement.childNodes.elems, 3, 'importNodes copies';
+    my @adopted = $doc3.adoptNodes(@kids);
+    ok @adopted[0].isSameNode(@kids[0]), 'adoptNodes';
+    ok @adopted.map(*.ownerDocument.isSameNode($doc3)).all.so, 'adoptNodes owner';
+    is @adopted[2].Str, '<a:y xmlns:a="urn:a"/>', 'adoptNodes namespaces';
+    is $src.documentElement.childNodes.elems, 0, 'adoptNodes unlinks';
+    my $ns = $src.documentElement.namespaces[0];
+    nok $doc3.importNodes([$ns]), 'importNodes rejects namespaces';
+    nok $doc3.adoptNodes([$ns]), 'adoptNodes rejects namespaces';
 }
 
 subtest 'appending empty fragment', {
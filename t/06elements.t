@@ -242,10 +242,22 @@ subtest 'Normalization on a Document node', {
 
     @cn = $e.childNodes;
     is +@cn, 2;
-
+    is @cn[1].data, 'bar1bar2bar3', 'merged content';
 
     nok defined($t2.parentNode);
     nok defined($t3.parentNode);
+
+    # long runs of text, nested deeply
+    my $depth = 1000;
+    my $elem = $e2;
+    for 1 .. $depth {
+        $elem.appendChild($doc.createTextNode($_)) for ^10;
+        $elem = $elem.appendChild: $doc.createElement("bar");
+    }
+    $doc.normalize;
+    is $e2.childNodes.elems, 2, 'deep normalization';
+    is $e2.firstChild.data, '0123456789', 'deep normalization content';
+    is $elem.parentNode.childNodes.elems, 2, 'deep normalization, innermost';
 }
 
 subtest 'LibXML extensions', {
@@ -125,6 +125,28 @@ subtest 'importing namespaces', {
     my LibXML::Item @attrb = $d.properties.Slip, $c.namespaces.Slip;
     is +@attrb, 1;
     is @attrb[0].nodeType, 18;
+
+    # deep and wide subtree, with redundant declarations at each level
+    my $depth = 200;
+    my Str $xml = [~] flat(
+        '<x:a xmlns:x="http://foo.bar" xmlns:y="http://y">',
+        ('<x:e xmlns:x="http://foo.bar" y:att="1"><y:f xmlns:y="http://other"/>' xx $depth),
+        ('</x:e>' xx $depth), '</x:a>',
+    );
+    my $deep = LibXML.parse(:string($xml)).documentElement;
+    my $root = $doca.createElementNS('http://foo.bar', 'x:root');
+    $doca.documentElement = $root;
+    $root.appendChild: $doca.importNode($deep);
+    my @elems = $root.findnodes('//x:e', :ns{ :x<http://foo.bar> });
+    is +@elems, $depth, 'deep import';
+    is @elems.grep(*.namespaces.elems).elems, 0, 'redundant declarations removed';
+    is @elems.tail.getAttributeNS('http://y', 'att'), '1', 'attribute namespace retained';
+    is $root.findnodes('//*[namespace-uri()="http://other"]').elems, $depth, 'shadowing declarations retained';
+
+    # element and attribute share a namespace declared above them
+    my $moved = LibXML.parse(:string('<r xmlns:z="urn:z"><z:m z:att="1"/></r>')).documentElement.firstChild;
+    $root.appendChild: $doca.adoptNode($moved);
+    is $moved.Str, '<z:m xmlns:z="urn:z" z:att="1"/>', 'namespace declared once when moved';
 }
 
 subtest 'lossless setting of namespaces with setAttribute',  {
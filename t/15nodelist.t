@@ -1,9 +1,10 @@
 use v6;
 use Test;
-plan 16;
+plan 20;
 
 use LibXML;
 use LibXML::Enums;
+use LibXML::Document;
 use LibXML::Node;
 use LibXML::Node::List;
 use LibXML::Node::Set;
@@ -50,6 +51,78 @@ subtest 'from findnodes()', {
     isa-ok $dom.find("//CCC"), "LibXML::Node::Set", 'find --> LibXML::Node::Set';
 }
 
+subtest 'hashing many siblings', {
+    my $n = 100_000;
+    my LibXML::Document $doc .= parse: :string('<r>' ~ ('<a/><b/><b/>' x $n) ~ '</r>');
+    my LibXML::HashMap[LibXML::Node::Set] $hash = $doc.documentElement.childNodes.Hash;
+    is $hash.keys.sort.join(','), 'a,b';
+    is $hash<a>.size, $n;
+    is $hash<b>.size, 2 * $n;
+}
+
+subtest 'iterating in blocks', {
+    my $n = 150;
+    my LibXML::Document $doc .= parse: :string('<r>' ~ ('<a/> <b>x</b>' x $n) ~ '<?pi?></r>');
+    my $elem = $doc.documentElement;
+    my @all = $elem.childNodes;
+    is +@all, 3 * $n + 1, 'list iteration';
+    is @all.tail.nodeType, +XML_PI_NODE, 'list tail';
+    my @nb = $elem.nonBlankChildNodes;
+    is +@nb, 2 * $n + 1, 'non-blank list iteration';
+    is @nb.grep(*.nodeName eq 'b').elems, $n, 'non-blank list content';
+    my LibXML::Node::Set $set = $elem.findnodes('b | b/text() | @* | namespace::*');
+    my @items = $set.list;
+    is +@items, 2 * $n + 1, 'set iteration';
+    is @items.grep(*.nodeType == XML_TEXT_NODE).elems, $n, 'set text items';
+    is @items.grep(*.nodeType == XML_NAMESPACE_DECL).elems, 1, 'set namespace items';
+    is @items.first(*.nodeType == XML_ELEMENT_NODE).Str, '<b>x</b>', 'set content';
+    @items = ();
+    $set = Nil;
+    is $elem.childNodes.head.nodeName, 'a', 'nodes survive';
+}
+
+subtest 'indexed membership and deletion', {
+    my $n = 1000;
+    my LibXML::Document $doc .= parse: :string('<r>' ~ ('<a/>' x $n) ~ '</r>');
+    my LibXML::Node::Set $set = $doc.findnodes('/r/a');
+    my @a = $set.list;
+    my $other = $doc.createElement('other');
+    ok $set.contains(@a[500]), 'contains';
+    nok $set.contains($other), 'contains, non-member';
+    ok $set.delete(@a[0]).isSameNode(@a[0]), 'delete';
+    ok $set[0].isSameNode(@a[1]), 'delete keeps order';
+    $set.delete(@a[1], :!keep-order);
+    ok $set[0].isSameNode(@a.tail), 'unordered delete';
+    is $set.elems, $n - 2, 'elems after delete';
+    nok $set.contains(@a[1]), 'deleted';
+    $set.add: $other;
+    ok $set.contains($other), 'contains after add';
+    ok $set.pop.isSameNode($other), 'pop';
+    nok $set.contains($other), 'contains after pop';
+    $set.delete($_, :!keep-order) for @a;
+    is $set.elems, 0, 'delete all';
+    ok $set.is-equiv($doc.findnodes('/r/a')) == False, 'is-equiv, empty';
+    ok $doc.findnodes('/r/a').is-equiv($doc.findnodes('/r/a[2]')), 'is-equiv';
+}
+
+subtest 'document order and set algebra', {
+    my LibXML::Document $doc .= parse: :string('<r><a/><b/><c/><d/><e/></r>');
+    ok $doc.stamp-order > 0, 'stamp-order';
+    is $doc.stamp-order, 0, 'stamp-order, when current';
+    my LibXML::Node::Set $set = $doc.findnodes('/r/*').reverse;
+    is $set.doc-order.map(*.tag).join, 'abcde', 'doc-order';
+    my $x = $doc.findnodes('/r/a | /r/c | /r/e');
+    my $y = $doc.findnodes('/r/c | /r/d').reverse;
+    is $x.union($y).map(*.tag).join, 'acde', 'union';
+    is $y.intersection($x).map(*.tag).join, 'c', 'intersection';
+    is $x.difference($y).map(*.tag).join, 'ae', 'difference';
+    my $a = $doc.documentElement.firstChild;
+    $doc.documentElement.appendChild($a);
+    is $doc.findnodes('/r/*').map(*.tag).join, 'bcdea', 'order after move';
+    is $set.doc-order.map(*.tag).join, 'bcdea', 'doc-order after move';
+    ok $doc.stamp-order(:force) > 0, 'stamp-order :force';
+}
+
 skip("port remaining tests", 14);
     
 =begin TODO
@@ -5,7 +5,7 @@ use LibXML;
 use LibXML::Config;
 use LibXML::RelaxNG;
 
-plan 5;
+plan 6;
 
 sub slurp(Str $_) { .IO.slurp }
 
@@ -88,3 +88,13 @@ subtest 're-validate a modified document', {
     $rootElem.removeAttribute('name');
     dies-ok {$rng.validate($doc);}, 'modified (broken) document dies';
 }
+
+subtest 'validate-many', {
+    my LibXML::RelaxNG $rngschema .= new: location => $file;
+    my @docs = (^10).map: { $xmlparser.parse: :file( $_ %% 2 ?? $validfile !! $invalidfile ) };
+
+    my @results = $rngschema.validate-many(@docs, :workers(3));
+    is-deeply @results.map(*<valid>).List, (^10).map(* %% 2).List, 'validity, in order';
+    ok @results[1]<errors>.elems, 'errors for invalid document';
+    nok @results[0]<errors>.elems, 'no errors for valid document';
+}
@@ -6,8 +6,10 @@ use LibXML::Config;
 use LibXML::Schema;
 use LibXML::InputCallback;
 use LibXML::Element;
+use LibXML::PushParser;
+use NativeCall;
 
-plan 5;
+plan 8;
 
 sub slurp(Str $_) { .IO.slurp }
 
@@ -136,3 +138,99 @@ subtest 'schema :network option', {
     ok $net-access, 'attempted network access';
     $input-callbacks.deactivate;
 }
+
+subtest 'compiled schema cache', {
+    LibXML::Config.schema-cache = True;
+    LibXML::Config.schema-cache-clear;
+    LEAVE {
+        LibXML::Config.schema-cache = False;
+        LibXML::Config.schema-cache-clear;
+    }
+
+    my LibXML::Schema $schema .= new: location => $file;
+    my LibXML::Schema $schema2 .= new: location => $file;
+    is LibXML::Config.schema-cache-elems, 1, 'location is cached';
+    my LibXML::Schema $schema3 .= new: string => slurp($file);
+    LibXML::Schema.new: string => slurp($file);
+    is LibXML::Config.schema-cache-elems, 2, 'string is cached';
+
+    dies-ok { LibXML::Schema.new( location => $badfile ) }, 'bad schema';
+    is LibXML::Config.schema-cache-elems, 2, 'bad schema is not cached';
+
+    LibXML::Schema.new: location => $file, :network;
+    is LibXML::Config.schema-cache-elems, 2, ':network schema is not cached';
+
+    my LibXML::InputCallback $input-callbacks .= new: :callbacks{
+        :match(sub ($f) {True}),
+        :open(sub ($_) { .IO.open(:r) }),
+        :read(sub ($fh, $n) {$fh.read($n)}),
+        :close(sub ($fh) {$fh.close}),
+    };
+    $input-callbacks.activate;
+    LibXML::Schema.new: string => slurp($file) ~ ' ';
+    is LibXML::Config.schema-cache-elems, 2, 'not cached with input callbacks';
+    $input-callbacks.deactivate;
+
+    {
+        my Bool $parser-locking = LibXML::Config.parser-locking;
+        LibXML::Config.parser-locking = True;
+        LEAVE LibXML::Config.parser-locking = $parser-locking;
+        my LibXML::Config $config .= new;
+        $config.external-entity-loader = -> $url, $ { $url.IO.slurp };
+        my LibXML::Schema $local .= new: location => $file, :$config;
+        isnt +nativecast(Pointer, $local.raw), +nativecast(Pointer, $schema.raw), 'not looked up with a local entity loader';
+        LibXML::Schema.new: string => slurp($file) ~ "\n", :$config;
+        is LibXML::Config.schema-cache-elems, 2, 'not cached with a local entity loader';
+    }
+
+    my $valid = $xmlparser.parse: :file( $validfile );
+    my $invalid = $xmlparser.parse: :file( $invalidfile );
+    for 1 .. 3 {
+        ok $schema2.is-valid($valid), "pooled context $_ (valid)";
+        nok $schema2.is-valid($invalid), "pooled context $_ (invalid)";
+    }
+
+    LibXML::Config.schema-cache-clear;
+    is LibXML::Config.schema-cache-elems, 0, 'schema-cache-clear';
+    ok $schema.is-valid($valid), 'schema retained after clear';
+}
+
+subtest 'streaming validation', {
+    my LibXML::Schema $Schema .= new: location => $file;
+
+    my @chunks = slurp($validfile).lines.map(* ~ "\n");
+    my LibXML::PushParser $push-parser .= new: :chunk(@chunks.shift), :$Schema;
+    $push-parser.push($_) for @chunks;
+    my $doc = $push-parser.finish-push;
+    is $doc.documentElement.tag, 'Item', 'document built';
+    is-deeply $push-parser.schema-valid, True, 'valid document';
+
+    @chunks = slurp($invalidfile).lines.map(* ~ "\n");
+    $push-parser .= new: :chunk(@chunks.shift), :$Schema;
+    throws-like { $push-parser.push($_) for @chunks; $push-parser.finish-push },
+        X::LibXML::Parser, :message(/'Schemas validity error'/), 'invalid document';
+
+    @chunks = slurp($invalidfile).lines.map(* ~ "\n");
+    $push-parser .= new: :chunk(@chunks.shift), :$Schema, :suppress-errors;
+    $push-parser.push($_) for @chunks;
+    ok $push-parser.finish-push.defined, 'invalid document, :suppress-errors';
+    is-deeply $push-parser.schema-valid, False, 'invalid document, schema-valid';
+}
+
+subtest 'validate-many', {
+    my LibXML::Schema $schema .= new: location => $file;
+    my @docs = (^20).map: { $xmlparser.parse: :file( $_ %% 2 ?? $validfile !! $invalidfile ) };
+
+    my @results = $schema.validate-many(@docs, :workers(4));
+    is +@results, 20, 'result per document';
+    is-deeply @results.map(*<valid>).List, (^20).map(* %% 2).List, 'validity, in order';
+    is-deeply @results.grep(*<valid>).map(*<errors>.elems).sum, 0, 'no errors for valid documents';
+    isa-ok @results[1]<errors>.head, X::LibXML::Parser, 'errors for invalid document';
+    like @results[1]<errors>.head.message, /'Schemas validity error'/, 'error message';
+
+    is-deeply $schema.validate-many(@docs, :workers(0)).map(*<valid>).List, (^20).map(* %% 2).List, 'calling thread only';
+    is-deeply $schema.validate-many(()), (), 'empty batch';
+
+    my @dups = @docs[0, 1, 0, 1, 1];
+    is-deeply $schema.validate-many(@dups, :workers(4)).map(*<valid>).List, (True, False, True, False, False), 'repeated documents';
+}
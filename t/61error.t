@@ -3,7 +3,7 @@ use Test;
 use LibXML;
 use LibXML::ErrorHandling;
 
-plan 3;
+plan 7;
 
 my LibXML $p .= new;
 
@@ -17,3 +17,25 @@ my $err = $!;
 isa-ok($err, X::LibXML::Parser, 'Exception is of type parser error.');
 is($err.domain(), 'parser', 'Error is in the parser domain');
 is($err.line(), 1, 'Error is on line 1.');
+
+{
+    # recovered errors are collected natively, then chained on flush
+    my Str $warning;
+    {
+        CONTROL { when CX::Warn { $warning = .message; .resume } }
+        $p.parse: :string("<r>\n" ~ ("<a>&x;</a>\n" x 50) ~ "</r>"), :recover;
+    }
+    is +$warning.lines.grep(/"Entity 'x' not defined"/), 50, 'recovered errors';
+    is $warning.lines.tail(2).head, '<a>&x;</a>', 'recovered error context';
+}
+
+{
+    my Str @warnings;
+    {
+        CONTROL { when CX::Warn { @warnings.push: .message; .resume } }
+        $p.parse: :string('<r xmlns="x"/>');
+        $p.parse: :string('<r xmlns="x"/>'), :suppress-warnings;
+    }
+    is +@warnings, 1, 'suppressed warnings';
+    like @warnings.head, /'not absolute'/, 'unsuppressed warning';
+}